@@ -0,0 +1,31 @@
+#include "AllocationCounter.h"
+
+namespace
+{
+    // Plain thread-locals, so reading them from operator new never allocates.
+    thread_local juce::int64* countedTarget = nullptr;
+    thread_local juce::int64* excludedTarget = nullptr;
+    thread_local int exclusionDepth = 0;
+}
+
+void AllocationCounter::noteAllocation() noexcept
+{
+    if (countedTarget != nullptr)
+        ++*(exclusionDepth > 0 ? excludedTarget : countedTarget);
+}
+
+AllocationCounter::AllocationCounter()
+{
+    jassert (countedTarget == nullptr);
+    countedTarget = &counted;
+    excludedTarget = &excluded;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    countedTarget = nullptr;
+    excludedTarget = nullptr;
+}
+
+AllocationCounter::ScopedExclusion::ScopedExclusion() noexcept      { ++exclusionDepth; }
+AllocationCounter::ScopedExclusion::~ScopedExclusion() noexcept     { --exclusionDepth; }
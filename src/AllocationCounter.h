@@ -0,0 +1,39 @@
+/*
+    Heap allocation counting for the EditAllocationCheck tool.
+
+    That tool replaces the global operator new with one that calls noteAllocation(), which
+    bumps a thread-local count while an AllocationCounter exists on that thread. The
+    application keeps the standard allocator; it only marks the track rebuild that follows
+    each edit (tracktion's graph and the edit-list file) with a ScopedExclusion, so the tool
+    counts that separately, since it allocates inside the engine.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class AllocationCounter
+{
+public:
+    /** Starts counting allocations made on the calling thread. Counters don't nest. */
+    AllocationCounter();
+    ~AllocationCounter();
+
+    juce::int64 getCount() const noexcept               { return counted; }
+    juce::int64 getExcludedCount() const noexcept       { return excluded; }
+
+    /** Allocations on this thread while one of these exists go to getExcludedCount() instead. */
+    struct ScopedExclusion
+    {
+        ScopedExclusion() noexcept;
+        ~ScopedExclusion() noexcept;
+    };
+
+    /** Called by a replacement operator new for every allocation. */
+    static void noteAllocation() noexcept;
+
+private:
+    juce::int64 counted = 0, excluded = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (AllocationCounter)
+};
@@ -1,7 +1,12 @@
 #include "AudioEngine.h"
+#include "AllocationCounter.h"
+#include "EditListAudioFormat.h"
+#include "SampleRateConverter.h"
+#include "Wave64AudioFormat.h"
 #include "../libs/tracktion_engine/examples/common/PluginWindow.h"
 #include "../libs/tracktion_engine/examples/common/Utilities.h"
 #include <algorithm>
+#include <cmath>
 
 using namespace tracktion::literals;
 using namespace std::literals;
@@ -76,6 +81,324 @@ namespace
         juce::ProgressBar progressBar;
     };
 
+    class AppEngineBehaviour : public te::EngineBehaviour
+    {
+    public:
+        // The device is opened by AudioEngine::initialiseAudioDevice() once the window is up.
+        bool autoInitialiseDeviceManager() override    { return false; }
+
+        // Tracks are mixed in parallel on the audio thread pool; one core is left for the UI.
+        int getNumberOfCPUsToUseForAudio() override    { return juce::jmax (1, juce::SystemStats::getNumCpus() - 1); }
+    };
+
+    using Segment = IAudioEngine::Segment;
+    using ClipboardFragment = IAudioEngine::ClipboardFragment;
+
+    te::TimeDuration getLength (const std::vector<Segment>& segments)
+    {
+        te::TimeDuration total;
+        for (auto& seg : segments)
+            total = total + seg.length;
+        return total;
+    }
+
+    // The segment helpers walk the segment list and the (sorted, disjoint) selection ranges
+    // together, so a batch of ranges costs one pass however many there are. They fill a
+    // caller-owned vector, which keeps its capacity from one edit to the next.
+
+    void copySegments (const std::vector<Segment>& segments, const SelectionSet& selection, std::vector<ClipboardFragment>& fragments)
+    {
+        fragments.clear();
+        auto& ranges = selection.getRanges();
+        auto range = ranges.begin();
+        te::TimeDuration rangeBase;     // combined length of the ranges before this one
+        te::TimePosition pos;
+
+        for (auto& seg : segments)
+        {
+            const auto segRange = te::TimeRange { pos, pos + seg.length };
+
+            while (range != ranges.end() && range->getStart() < segRange.getEnd())
+            {
+                const auto intersection = segRange.getIntersectionWith (*range);
+
+                if (! intersection.isEmpty())
+                {
+                    auto relStart = rangeBase + (intersection.getStart() - range->getStart());
+                    auto offset = seg.sourceOffset + (intersection.getStart() - segRange.getStart());
+                    fragments.push_back ({ relStart, intersection.getLength(), offset, seg.source });
+                }
+
+                if (range->getEnd() > segRange.getEnd())
+                    break;
+
+                rangeBase = rangeBase + range->getLength();
+                ++range;
+            }
+
+            pos = pos + seg.length;
+        }
+    }
+
+    void cutSegments (const std::vector<Segment>& segments, const SelectionSet& selection, std::vector<Segment>& newSegments)
+    {
+        newSegments.clear();
+        auto& ranges = selection.getRanges();
+        auto range = ranges.begin();
+        te::TimePosition pos;
+
+        for (auto& seg : segments)
+        {
+            const auto segEnd = pos + seg.length;
+            auto keepFrom = pos;
+
+            while (range != ranges.end() && range->getStart() < segEnd)
+            {
+                if (range->getStart() > keepFrom)
+                    newSegments.push_back ({ range->getStart() - keepFrom, seg.sourceOffset + (keepFrom - pos), seg.source });
+
+                keepFrom = std::max (keepFrom, range->getEnd());
+
+                if (range->getEnd() > segEnd)
+                    break;
+
+                ++range;
+            }
+
+            if (keepFrom < segEnd)
+                newSegments.push_back ({ segEnd - keepFrom, seg.sourceOffset + (keepFrom - pos), seg.source });
+
+            pos = segEnd;
+        }
+    }
+
+    // Fills the gaps between fragments, and the rest of length, with silence and drops anything
+    // past length, so a linked track's clipboard is exactly as long as the main one and pasting
+    // moves everything after the insertion point on both by the same amount.
+    void fitFragments (const std::vector<ClipboardFragment>& fragments, te::TimeDuration length,
+                       std::vector<ClipboardFragment>& fitted)
+    {
+        fitted.clear();
+        te::TimeDuration cursor;
+
+        for (auto& frag : fragments)
+        {
+            if (frag.relativeStart >= length)
+                break;
+
+            if (frag.relativeStart > cursor)
+                fitted.push_back ({ cursor, frag.relativeStart - cursor, 0s, juce::File() });
+
+            const auto fragLength = std::min (frag.length, length - frag.relativeStart);
+            fitted.push_back ({ frag.relativeStart, fragLength, frag.sourceOffset, frag.source });
+            cursor = frag.relativeStart + fragLength;
+        }
+
+        if (cursor < length)
+            fitted.push_back ({ cursor, length - cursor, 0s, juce::File() });
+    }
+
+    // Fragments come from copySegments(), which produces them in order, so the clipboard
+    // never needs sorting.
+    void insertSegments (const std::vector<Segment>& segments, te::TimePosition insertion,
+                         const std::vector<ClipboardFragment>& fragments, std::vector<Segment>& newSegments)
+    {
+        jassert (std::is_sorted (fragments.begin(), fragments.end(),
+                                 [] (const ClipboardFragment& a, const ClipboardFragment& b) { return a.relativeStart < b.relativeStart; }));
+
+        newSegments.clear();
+
+        auto appendFragments = [&]
+        {
+            for (auto& frag : fragments)
+                newSegments.push_back ({ frag.length, frag.sourceOffset, frag.source });
+        };
+
+        te::TimePosition pos;
+        bool inserted = false;
+
+        for (auto& seg : segments)
+        {
+            const auto segRange = te::TimeRange { pos, pos + seg.length };
+
+            if (! inserted && insertion < segRange.getEnd())
+            {
+                auto preLen = insertion - segRange.getStart();
+                auto postLen = segRange.getEnd() - insertion;
+
+                if (preLen > 0s)
+                    newSegments.push_back ({ preLen, seg.sourceOffset, seg.source });
+
+                appendFragments();
+
+                if (postLen > 0s)
+                {
+                    auto newOffset = seg.sourceOffset + (seg.length - postLen);
+                    newSegments.push_back ({ postLen, newOffset, seg.source });
+                }
+
+                inserted = true;
+            }
+            else
+            {
+                newSegments.push_back (seg);
+            }
+
+            pos = pos + seg.length;
+        }
+
+        if (! inserted)
+            appendFragments();
+    }
+
+    using Marker = IAudioEngine::Marker;
+
+    // Markers inside a removed range end up where it was; later ones move back by the
+    // length removed before them.
+    void removeFromMarkers (std::vector<Marker>& markers, const SelectionSet& selection)
+    {
+        for (auto& marker : markers)
+        {
+            te::TimeDuration removed;
+
+            for (auto& range : selection.getRanges())
+            {
+                if (range.getStart() >= marker.position)
+                    break;
+
+                removed = removed + (std::min (range.getEnd(), marker.position) - range.getStart());
+            }
+
+            marker.position = marker.position - removed;
+        }
+    }
+
+    // A marker exactly at the insertion point stays put, so inserted audio joins the region it starts.
+    void insertIntoMarkers (std::vector<Marker>& markers, te::TimePosition insertion, te::TimeDuration length)
+    {
+        for (auto& marker : markers)
+            if (marker.position > insertion)
+                marker.position = marker.position + length;
+    }
+
+    te::TimeDuration getFragmentsLength (const std::vector<ClipboardFragment>& fragments)
+    {
+        te::TimeDuration length;
+        for (auto& frag : fragments)
+            length = length + frag.length;
+        return length;
+    }
+
+    // Replaces each piece of a consolidated file with the pieces of source it was rendered from,
+    // so anything keyed on the original sources still finds them.
+    void expandConsolidated (const std::vector<Segment>& segments, const std::map<juce::File, std::vector<Segment>>& origins,
+                             std::vector<Segment>& expanded)
+    {
+        expanded.clear();
+
+        for (auto& seg : segments)
+        {
+            const auto found = origins.find (seg.source);
+
+            if (found == origins.end())
+            {
+                expanded.push_back (seg);
+                continue;
+            }
+
+            const auto segStart = seg.sourceOffset.inSeconds();
+            const auto segEnd = segStart + seg.length.inSeconds();
+            double pos = 0.0;
+
+            for (auto& origin : found->second)
+            {
+                const auto start = std::max (segStart, pos);
+                const auto end = std::min (segEnd, pos + origin.length.inSeconds());
+
+                if (end > start)
+                    expanded.push_back ({ te::TimeDuration::fromSeconds (end - start),
+                                          origin.sourceOffset + te::TimeDuration::fromSeconds (start - pos), origin.source });
+
+                pos += origin.length.inSeconds();
+            }
+        }
+    }
+
+    // Neighbours that continue each other in the same source (or are both silence) become one
+    // segment, so cut/paste/undo cycles don't leave the list more fragmented than the audio.
+    void coalesceSegments (std::vector<Segment>& segments)
+    {
+        constexpr double contiguityTolerance = 1.0e-6;
+        size_t last = 0;
+
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            auto& seg = segments[i];
+
+            if (seg.length <= 0s)
+                continue;
+
+            if (last > 0)
+            {
+                auto& prev = segments[last - 1];
+                const bool contiguous = seg.source == prev.source
+                                         && (seg.source == juce::File()
+                                              || std::abs ((prev.sourceOffset + prev.length - seg.sourceOffset).inSeconds()) < contiguityTolerance);
+
+                if (contiguous)
+                {
+                    prev.length = prev.length + seg.length;
+                    continue;
+                }
+            }
+
+            if (last != i)
+                segments[last] = std::move (seg);
+
+            ++last;
+        }
+
+        segments.resize (last);
+    }
+
+    // Runs of at least this many consecutive segments, each shorter than maxFragmentSeconds,
+    // are what consolidateFragments() renders into a contiguous file.
+    constexpr int minFragmentRun = 8;
+    constexpr double maxFragmentSeconds = 2.0;
+
+    bool writeTimelineRange (juce::AudioFormatManager& formatManager, const juce::File& timeline,
+                             juce::int64 startSample, juce::int64 numSamples, const juce::File& dest)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (timeline));
+        if (reader == nullptr)
+            return false;
+
+        auto part = dest.withFileExtension ("part");
+        dest.getParentDirectory().createDirectory();
+        part.deleteFile();
+
+        {
+            auto out = part.createOutputStream();
+            juce::WavAudioFormat wav;
+            std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? wav.createWriterFor (out.get(), reader->sampleRate,
+                                                                                                   reader->numChannels, 32, {}, 0)
+                                                                            : nullptr);
+            if (writer == nullptr)
+                return false;
+
+            out.release();
+
+            if (! writer->writeFromAudioReader (*reader, startSample, numSamples))
+            {
+                writer.reset();
+                part.deleteFile();
+                return false;
+            }
+        }
+
+        return part.moveFileTo (dest);
+    }
+
     class AppUIBehaviour : public ExtendedUIBehaviour
     {
     public:
@@ -109,10 +432,44 @@ namespace
     };
 }
 
-AudioEngine::AudioEngine()
-    : engine (ProjectInfo::projectName, std::make_unique<AppUIBehaviour>(), nullptr)
+AudioEngine::AudioEngine (bool openAudioDevice)
+    : engine (ProjectInfo::projectName, std::make_unique<AppUIBehaviour>(), std::make_unique<AppEngineBehaviour>()),
+      audioDeviceAllowed (openAudioDevice)
 {
+    auto& readFormats = engine.getAudioFileFormatManager().readFormatManager;
+    readFormats.registerFormat (new EditListAudioFormat (readFormats), false);
+    readFormats.registerFormat (new Wave64AudioFormat(), false);
+
+    undoStack.reserve (maxUndoHistory);
+
+    backgroundThread.startThread();
+    engine.getDeviceManager().deviceManager.addAudioCallback (&scrubEngine);
+    engine.getDeviceManager().deviceManager.addAudioCallback (&takeRecorder);
+    engine.getDeviceManager().deviceManager.addAudioCallback (&loopPreview);
+}
+
+bool AudioEngine::initialiseAudioDevice()
+{
+    if (! audioDeviceAllowed)
+        return false;
+
+    if (audioDeviceInitialised)
+        return true;
+
+    const auto startMs = juce::Time::getMillisecondCounterHiRes();
+    audioDeviceInitialised = true;
+
+    // Open outputs only; inputs are enabled on demand by enableAllInputChannels(),
+    // which is what made startup slow on interfaces with many channels.
     auto& devMan = engine.getDeviceManager();
+    devMan.initialise (0, 2);
+
+    // tracktion's DeviceManager registers itself as the device callback. The base isn't
+    // necessarily accessible, and a C-style cast is the conversion that ignores access; the
+    // assertion keeps it from ever compiling into a reinterpretation.
+    static_assert (std::is_base_of_v<juce::AudioIODeviceCallback, te::DeviceManager>);
+    performanceMonitor.timeEngineCallback ((juce::AudioIODeviceCallback&) devMan);
+
     juce::AudioDeviceManager::AudioDeviceSetup setup;
     devMan.deviceManager.getAudioDeviceSetup (setup);
 
@@ -121,19 +478,6 @@ AudioEngine::AudioEngine()
     const auto sr = currentDevice != nullptr ? currentDevice->getCurrentSampleRate() : setup.sampleRate;
     const auto buffer = currentDevice != nullptr ? currentDevice->getCurrentBufferSizeSamples() : setup.bufferSize;
 
-    if (currentDevice != nullptr)
-    {
-        const int availableInputs = currentDevice->getInputChannelNames().size();
-        const int activeInputs = setup.inputChannels.countNumberOfSetBits();
-
-        if (availableInputs > 0 && activeInputs < availableInputs)
-        {
-            setup.inputChannels.setRange (0, availableInputs, true);
-            devMan.deviceManager.setAudioDeviceSetup (setup, true);
-            devMan.rescanWaveDeviceList();
-        }
-    }
-
     juce::String info;
     info << "Audio device: " << deviceName
          << " | input: " << (setup.inputDeviceName.isNotEmpty() ? setup.inputDeviceName : "<none>")
@@ -142,9 +486,52 @@ AudioEngine::AudioEngine()
          << " (" << setup.outputChannels.countNumberOfSetBits() << " ch)"
          << " | rate: " << sr << " Hz"
          << " | buffer: " << buffer << " samples"
-         << " | latency: " << juce::String (devMan.getOutputLatencySeconds(), 4) << " s";
+         << " | latency: " << juce::String (devMan.getOutputLatencySeconds(), 4) << " s"
+         << " | opened in " << juce::String (juce::Time::getMillisecondCounterHiRes() - startMs, 1) << " ms";
+
+    performanceMonitor.logEvent (info);
+    return currentDevice != nullptr;
+}
+
+void AudioEngine::enableAllInputChannels()
+{
+    initialiseAudioDevice();
+
+    auto& devMan = engine.getDeviceManager();
+    juce::AudioDeviceManager::AudioDeviceSetup setup;
+    devMan.deviceManager.getAudioDeviceSetup (setup);
+
+    auto* currentDevice = devMan.deviceManager.getCurrentAudioDevice();
+    if (currentDevice == nullptr)
+        return;
+
+    const int availableInputs = currentDevice->getInputChannelNames().size();
+    const int activeInputs = setup.inputChannels.countNumberOfSetBits();
+
+    if (availableInputs > 0 && activeInputs < availableInputs)
+    {
+        setup.inputChannels.setRange (0, availableInputs, true);
+        devMan.deviceManager.setAudioDeviceSetup (setup, true);
+        devMan.rescanWaveDeviceList();
+    }
+}
 
-    DBG (info);
+AudioEngine::~AudioEngine()
+{
+    engine.getDeviceManager().deviceManager.removeAudioCallback (&loopPreview);
+    engine.getDeviceManager().deviceManager.removeAudioCallback (&takeRecorder);
+    engine.getDeviceManager().deviceManager.removeAudioCallback (&scrubEngine);
+    loopPreview.stop();
+    takeRecorder.stop();
+    scrubEngine.stop();
+    backgroundThread.stopThread (2000);
+
+    // Background jobs (finishing takes, copying pastes) use members declared after the pool.
+    loadPool.removeAllJobs (true, 10000);
+
+    // Nothing outlives this instance's timeline and history, so everything it generated can go.
+    for (auto& file : generatedFiles)
+        file.deleteFile();
 }
 
 te::Engine& AudioEngine::getEngine()
@@ -164,19 +551,37 @@ te::AudioTrack* AudioEngine::getTrack()
 
 bool AudioEngine::createNewEdit (const juce::String& tempName)
 {
+    stopLoopPreview();
+    cancelLoad();
+
+    // A take in progress belongs to the edit being replaced, and reads its playback context.
+    if (takeRecorder.isRecording())
+    {
+        takeRecorder.stop();
+        currentTakeFile.deleteFile();
+        currentTakeFile = juce::File();
+    }
+
     auto editFile = engine.getTemporaryFileManager().getTempFile (tempName)
                       .withFileExtension (te::projectFileSuffix);
     edit = te::createEmptyEdit (engine, editFile);
     edit->playInStopEnabled = true;
 
     track = EngineHelpers::getOrInsertAudioTrackAt (*edit, 0);
+    extraTracks.clear();
     segments.clear();
+    sourceSegments.clear();
+    consolidatedOrigins.clear();
     clipboard.clear();
+    markers.clear();
     thumbnail.reset();
+    thumbnailFile = juce::File();
     loadedFile = juce::File();
     loadedFileLength = 0s;
     insertionPoint = 0_tp;
     undoStack.clear();
+    fingerprintIndex.clear();
+    deleteUnreferencedFiles();
     return track != nullptr;
 }
 
@@ -196,350 +601,1724 @@ bool AudioEngine::loadFile (const juce::File& file, juce::String& statusOut)
         return false;
     }
 
-    loadedFile = file;
-    loadedFileLength = te::TimeDuration::fromSeconds (audioFile.getLength());
-    segments.clear();
-    clipboard.clear();
-    insertionPoint = 0_tp;
+    cancelLoad();
+    installLoadedFile (file, te::TimeDuration::fromSeconds (audioFile.getLength()));
+    statusOut = "Loaded " + file.getFileName();
+    return true;
+}
+
+void AudioEngine::loadFileAsync (const juce::File& file, std::function<void (bool, const juce::String&)> onComplete)
+{
+    const auto generation = ++loadGeneration;
+    loadPending = true;
+
+    loadPool.addJob ([this, file, generation, onComplete, weakThis = juce::WeakReference<AudioEngine> (this)]
+    {
+        // Reading the header is the slow part on a network disk; the file info ends up
+        // cached, so the message thread doesn't read it again.
+        te::AudioFile audioFile (engine, file);
+        const bool valid = audioFile.isValid();
+        const auto length = valid ? audioFile.getLength() : 0.0;
+
+        juce::MessageManager::callAsync ([weakThis, file, generation, onComplete, valid, length]
+        {
+            if (weakThis == nullptr || weakThis->loadGeneration != generation)
+                return;
+
+            auto& self = *weakThis;
+            self.loadPending = false;
+            juce::String status;
+
+            if (self.edit == nullptr)
+                status = "No edit available";
+            else if (! valid)
+                status = "Unsupported audio file";
+            else
+                status = "Loaded " + file.getFileName();
+
+            const bool loaded = self.edit != nullptr && valid;
+
+            if (loaded)
+                self.installLoadedFile (file, te::TimeDuration::fromSeconds (length));
+
+            if (onComplete != nullptr)
+                onComplete (loaded, status);
+        });
+    });
+}
+
+void AudioEngine::cancelLoad()
+{
+    ++loadGeneration;
+    loadPending = false;
+}
+
+bool AudioEngine::isLoading() const
+{
+    return loadPending;
+}
+
+void AudioEngine::setPlaylist (const juce::Array<juce::File>& files)
+{
+    playlist = files;
+    playlistIndex = -1;
+    playlistPrefetcher.clear();
+    prefetchedThumbnails.clear();
+}
+
+const juce::Array<juce::File>& AudioEngine::getPlaylist() const
+{
+    return playlist;
+}
+
+int AudioEngine::getPlaylistIndex() const
+{
+    return playlistIndex;
+}
+
+bool AudioEngine::loadPlaylistItem (int index, std::function<void (bool, const juce::String&)> onComplete)
+{
+    if (! juce::isPositiveAndBelow (index, playlist.size()))
+        return false;
+
+    playlistIndex = index;
+    loadFileAsync (playlist.getReference (index), std::move (onComplete));
+    updatePlaylistPrefetch();
+    return true;
+}
+
+void AudioEngine::updatePlaylistPrefetch()
+{
+    juce::Array<juce::File> upcoming;
+
+    for (int i = playlistIndex + 1; i < std::min (playlist.size(), playlistIndex + 1 + playlistPrefetchDepth); ++i)
+        upcoming.add (playlist.getReference (i));
+
+    playlistPrefetcher.prefetch (upcoming);
+
+    // Thumbnails scan in the background as soon as they exist, so the upcoming files' waveforms
+    // are ready when they're loaded. The one for the file being loaded now is kept until
+    // updateDisplayThumbnailFromTrack() takes it.
+    const auto& current = playlist.getReference (playlistIndex);
+
+    prefetchedThumbnails.erase (std::remove_if (prefetchedThumbnails.begin(), prefetchedThumbnails.end(),
+                                                [&] (const auto& t) { return t.first != current && ! upcoming.contains (t.first); }),
+                                prefetchedThumbnails.end());
+
+    for (auto& file : upcoming)
+    {
+        proxyCache.request (file, nullptr);
+
+        const bool hasThumbnail = std::any_of (prefetchedThumbnails.begin(), prefetchedThumbnails.end(),
+                                               [&] (const auto& t) { return t.first == file; });
+
+        if (! hasThumbnail && file.existsAsFile() && file != thumbnailFile)
+            prefetchedThumbnails.emplace_back (file, std::make_unique<te::SmartThumbnail> (engine, te::AudioFile (engine, file),
+                                                                                           thumbnailComponent, nullptr));
+    }
+}
+
+void AudioEngine::installLoadedFile (const juce::File& file, TimeDuration length)
+{
+    removeExtraTracks();
+    loadedFile = file;
+    loadedFileLength = length;
+    segments.clear();
+    clipboard.clear();
+    markers.clear();
+    insertionPoint = 0_tp;
+
+    segments.push_back ({ loadedFileLength, 0s, loadedFile });
+
+    rebuildTrack();
+    fingerprintIndex.build (loadedFile);
+    requestProxy (loadedFile);
+}
+
+const std::vector<IAudioEngine::Segment>& AudioEngine::getSegments() const
+{
+    return segments;
+}
+
+const std::vector<IAudioEngine::Segment>& AudioEngine::getSourceSegments() const
+{
+    return consolidatedOrigins.empty() ? segments : sourceSegments;
+}
+
+IAudioEngine::TimeDuration AudioEngine::getTotalLength() const
+{
+    return getLength (segments);
+}
+
+te::SmartThumbnail* AudioEngine::getThumbnail() const
+{
+    return thumbnail.get();
+}
+
+juce::File AudioEngine::getDisplayFile() const
+{
+    return displayFile;
+}
+
+juce::File AudioEngine::getSourceFile() const
+{
+    return loadedFile;
+}
+
+void AudioEngine::setInsertionPoint (TimePosition pos)
+{
+    insertionPoint = clampToTimeline (pos);
+
+    if (edit != nullptr)
+        edit->getTransport().setPosition (insertionPoint);
+}
+
+IAudioEngine::TimePosition AudioEngine::getInsertionPoint() const
+{
+    return insertionPoint;
+}
+
+bool AudioEngine::copySelection (TimeRange selection)
+{
+    scratchSelection.clear();
+    scratchSelection.add (selection);
+    return copySelections (scratchSelection);
+}
+
+bool AudioEngine::cutSelection (TimeRange selection)
+{
+    scratchSelection.clear();
+    scratchSelection.add (selection);
+    return deleteSelections (scratchSelection);
+}
+
+void AudioEngine::cutTrack (std::vector<Segment>& trackSegments, const SelectionSet& selection)
+{
+    // The result is built in the scratch vector and swapped in, so the two buffers trade
+    // places and neither is reallocated once both are big enough.
+    cutSegments (trackSegments, selection, scratchSegments);
+    std::swap (trackSegments, scratchSegments);
+}
+
+void AudioEngine::insertIntoTrack (std::vector<Segment>& trackSegments, TimePosition insertion,
+                                   const std::vector<ClipboardFragment>& fragments)
+{
+    // A linked track that ends before the insertion point is padded up to it, otherwise the
+    // insert would land at its end rather than in line with the main track.
+    const auto trackEnd = TimePosition::fromSeconds (getLength (trackSegments).inSeconds());
+
+    if (insertion > trackEnd)
+        trackSegments.push_back ({ insertion - trackEnd, 0s, juce::File() });
+
+    insertSegments (trackSegments, insertion, fragments, scratchSegments);
+    std::swap (trackSegments, scratchSegments);
+}
+
+void AudioEngine::insertIntoTrack (std::vector<Segment>& trackSegments, TimePosition insertion, const ClipboardFragment& fragment)
+{
+    scratchFragments.clear();
+    scratchFragments.push_back (fragment);
+    insertIntoTrack (trackSegments, insertion, scratchFragments);
+}
+
+bool AudioEngine::copySelections (const SelectionSet& selection)
+{
+    copySegments (segments, selection, scratchFragments);
+    const auto length = scratchFragments.empty() ? TimeDuration()
+                                                 : scratchFragments.back().relativeStart + scratchFragments.back().length;
+    fitFragments (scratchFragments, length, clipboard);
+
+    for (auto& extra : extraTracks)
+    {
+        if (extra.linked)
+        {
+            copySegments (extra.segments, selection, scratchFragments);
+            fitFragments (scratchFragments, length, extra.clipboard);
+        }
+        else
+        {
+            extra.clipboard.clear();
+        }
+    }
+
+    if (clipboard.empty())
+        return false;
+
+    publishClipboard();
+    return true;
+}
+
+bool AudioEngine::cutSelections (const SelectionSet& selection)
+{
+    return copySelections (selection) && deleteSelections (selection);
+}
+
+bool AudioEngine::deleteSelections (const SelectionSet& selection)
+{
+    if (segments.empty() || selection.isEmpty())
+        return false;
+
+    cutTrack (segments, selection);
+    removeFromMarkers (markers, selection);
+
+    for (auto& extra : extraTracks)
+        if (extra.linked)
+            cutTrack (extra.segments, selection);
+
+    rebuildTrack();
+    return true;
+}
+
+bool AudioEngine::normaliseSelections (const SelectionSet& selection, juce::String& statusOut)
+{
+    int numNormalised = 0;
+
+    for (auto& range : selection.getRanges())
+        if (normaliseRange (range, statusOut))
+            ++numNormalised;
+
+    if (selection.getRanges().size() > 1)
+        statusOut = "Normalised " + juce::String (numNormalised) + " of " + juce::String ((int) selection.getRanges().size()) + " ranges";
+
+    return numNormalised > 0;
+}
+
+bool AudioEngine::pasteClipboard (TimePosition insertAt)
+{
+    // A copy made in another instance since our last copy or paste wins over the local clipboard.
+    // If some of it has to be copied or converted first, the paste is made once that's done.
+    if (takeSharedClipboard (insertAt))
+        return true;
+
+    if (clipboard.empty() || sharedPastePending)
+        return false;
+
+    auto insertion = clampToTimeline (insertAt);
+    const auto length = getFragmentsLength (clipboard);
+    insertIntoTrack (segments, insertion, clipboard);
+    insertIntoMarkers (markers, insertion, length);
+
+    // A linked track whose clipboard doesn't match (it was unlinked at copy time, or the
+    // clipboard came from another instance) gets the same length of silence instead.
+    for (auto& extra : extraTracks)
+    {
+        if (! extra.linked)
+            continue;
+
+        if (std::abs ((getFragmentsLength (extra.clipboard) - length).inSeconds()) < 1.0e-6)
+            insertIntoTrack (extra.segments, insertion, extra.clipboard);
+        else
+            insertIntoTrack (extra.segments, insertion, ClipboardFragment { 0s, length, 0s, juce::File() });
+    }
+
+    rebuildTrack();
+    return true;
+}
+
+bool AudioEngine::hasClipboard() const
+{
+    return ! clipboard.empty() || sharedClipboard.hasChanged();
+}
+
+void AudioEngine::publishClipboard()
+{
+    sharedFragments.clear();
+
+    for (auto& frag : clipboard)
+        sharedFragments.push_back ({ frag.relativeStart.inSeconds(), frag.length.inSeconds(), frag.sourceOffset.inSeconds(), frag.source });
+
+    if (! sharedClipboard.publish (sharedFragments))
+        DBG ("Couldn't share the clipboard with other instances");
+}
+
+bool AudioEngine::takeSharedClipboard (TimePosition pasteAt)
+{
+    if (sharedPastePending)
+        return false;
+
+    auto shared = sharedClipboard.fetchIfChanged();
+
+    if (! shared.has_value() || shared->empty() || loadedFile == juce::File())
+        return false;
+
+    // The fragments refer to the other instance's sources directly. Only a source at a
+    // different rate from ours needs new audio, and then just the copied part of it. So does
+    // audio the other instance generated (a take, say), since it deletes that once it's done.
+    const auto targetRate = te::AudioFile (engine, loadedFile).getSampleRate();
+    std::vector<ClipboardFragment> fragments;
+    std::vector<size_t> toConvert;
+    fragments.reserve (shared->size());
+
+    for (auto& frag : *shared)
+    {
+        ClipboardFragment fragment { TimeDuration::fromSeconds (frag.relativeStart), TimeDuration::fromSeconds (frag.length),
+                                     TimeDuration::fromSeconds (frag.sourceOffset), frag.source };
+
+        if (frag.source != juce::File())
+        {
+            const auto sourceRate = te::AudioFile (engine, frag.source).getSampleRate();
+
+            if (sourceRate <= 0.0)
+            {
+                DBG ("Shared clipboard source is missing: " + frag.source.getFullPathName());
+                return false;
+            }
+
+            const bool ownedElsewhere = isGeneratedAudio (frag.source) && generatedFiles.count (frag.source) == 0;
+
+            if (ownedElsewhere || std::abs (sourceRate - targetRate) > 0.5)
+                toConvert.push_back (fragments.size());
+        }
+
+        fragments.push_back (fragment);
+    }
+
+    if (toConvert.empty())
+    {
+        installSharedClipboard (std::move (fragments));
+        return false;
+    }
+
+    // Copying and resampling can take a while for a long paste, so it's done like a take: in
+    // the background, with the result inserted as its own undo step on the message thread.
+    sharedPastePending = true;
+
+    loadPool.addJob ([this, shared = std::move (*shared), fragments = std::move (fragments), toConvert, targetRate, pasteAt,
+                      source = loadedFile, weakThis = juce::WeakReference<AudioEngine> (this)]() mutable
+    {
+        bool converted = true;
+
+        for (auto index : toConvert)
+        {
+            fragments[index].source = convertPastedFragment (shared[index], targetRate);
+            fragments[index].sourceOffset = 0s;
+            converted = converted && fragments[index].source != juce::File();
+        }
+
+        juce::MessageManager::callAsync ([weakThis, fragments, toConvert, converted, pasteAt, source]
+        {
+            // Copies already in use (the same audio pasted before) are left alone.
+            auto deleteCopies = [&] (const std::set<juce::File>& inUse)
+            {
+                for (auto index : toConvert)
+                    if (fragments[index].source != juce::File() && inUse.count (fragments[index].source) == 0)
+                        fragments[index].source.deleteFile();
+            };
+
+            if (weakThis == nullptr)
+            {
+                deleteCopies ({});
+                return;
+            }
+
+            auto& self = *weakThis;
+            self.sharedPastePending = false;
+
+            if (! converted || self.edit == nullptr || self.loadedFile != source)
+            {
+                DBG ("Couldn't paste from the shared clipboard");
+                deleteCopies (self.generatedFiles);
+                return;
+            }
+
+            for (auto index : toConvert)
+                self.adoptGeneratedFile (fragments[index].source);
+
+            self.installSharedClipboard (fragments);
+            self.pushUndoState (std::nullopt, pasteAt);
+            self.pasteClipboard (pasteAt);
+        });
+    });
+
+    return true;
+}
+
+void AudioEngine::installSharedClipboard (std::vector<ClipboardFragment> fragments)
+{
+    clipboard = std::move (fragments);
+
+    // Linked tracks get the same length of silence so they stay aligned.
+    const auto length = getFragmentsLength (clipboard);
+
+    for (auto& extra : extraTracks)
+        extra.clipboard = extra.linked ? std::vector<ClipboardFragment> { { 0s, length, 0s, juce::File() } }
+                                       : std::vector<ClipboardFragment>();
+}
+
+juce::File AudioEngine::convertPastedFragment (const SharedClipboard::Fragment& frag, double targetRate)
+{
+    // Named per instance as well as by content, since each instance deletes its own copies.
+    auto dir = engine.getPropertyStorage().getAppPrefsFolder().getChildFile ("Pasted");
+    const auto name = juce::String::toHexString ((editListDirectory.directory.getFileName() + "|" + frag.source.getFullPathName()
+                                                    + "|" + juce::String (frag.sourceOffset) + "|" + juce::String (frag.length)
+                                                    + "|" + juce::String (targetRate)).hashCode64());
+    auto dest = dir.getChildFile (name + ".wav");
+
+    if (dest.existsAsFile())
+        return dest;
+
+    std::unique_ptr<juce::AudioFormatReader> reader (engine.getAudioFileFormatManager().readFormatManager
+                                                        .createReaderFor (proxyCache.resolve (frag.source)));
+    if (reader == nullptr)
+        return {};
+
+    // convertFile() reads a float WAV, so the copied range is extracted into one first.
+    auto extract = dir.getChildFile (name + ".part.wav");
+    dir.createDirectory();
+    extract.deleteFile();
+
+    {
+        auto out = extract.createOutputStream();
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? wav.createWriterFor (out.get(), reader->sampleRate,
+                                                                                               reader->numChannels, 32, {}, 0)
+                                                                        : nullptr);
+        if (writer == nullptr)
+            return {};
+
+        out.release();
+
+        const auto start = (juce::int64) std::llround (frag.sourceOffset * reader->sampleRate);
+        const auto numSamples = (juce::int64) std::llround (frag.length * reader->sampleRate);
+
+        if (! writer->writeFromAudioReader (*reader, start, numSamples))
+        {
+            writer.reset();
+            extract.deleteFile();
+            return {};
+        }
+    }
+
+    // Already at our rate: the extracted range is the copy.
+    if (std::abs (reader->sampleRate - targetRate) <= 0.5)
+    {
+        if (extract.moveFileTo (dest))
+            return dest;
+
+        extract.deleteFile();
+        return {};
+    }
+
+    juce::WavAudioFormat wav;
+    std::atomic<float> progress { 0.0f };
+    const bool converted = SampleRateConverter::convertFile (extract, dest, wav, targetRate, 32, 0, false,
+                                                             SampleRateConverter::Quality::high, progress);
+    extract.deleteFile();
+
+    if (! converted)
+    {
+        dest.deleteFile();
+        return {};
+    }
+
+    return dest;
+}
+
+void AudioEngine::pushUndoState (const std::optional<TimeRange>& selection, TimePosition insertion)
+{
+    // Inside a batch the state pushed by beginBatch() already covers everything.
+    if (applyingUndo || batchDepth > 0)
+        return;
+
+    // States are recycled (the oldest once the history is full, otherwise the one the last
+    // undo left behind) and copying into their vectors reuses their storage.
+    UndoState state;
+
+    if (undoStack.size() >= maxUndoHistory)
+    {
+        state = std::move (undoStack.front());
+        undoStack.erase (undoStack.begin());
+    }
+    else
+    {
+        state = std::move (spareUndoState);
+    }
+
+    state.segments = segments;
+    state.clipboard = clipboard;
+    state.markers = markers;
+    state.selection = selection;
+    state.insertionPoint = insertion;
+    state.loadedFile = loadedFile;
+    state.loadedFileLength = loadedFileLength;
+    state.extraTracks.resize (extraTracks.size());
+
+    for (size_t i = 0; i < extraTracks.size(); ++i)
+    {
+        state.extraTracks[i].segments = extraTracks[i].segments;
+        state.extraTracks[i].clipboard = extraTracks[i].clipboard;
+        state.extraTracks[i].source = extraTracks[i].source;
+        state.extraTracks[i].linked = extraTracks[i].linked;
+    }
+
+    undoStack.push_back (std::move (state));
+}
+
+bool AudioEngine::undo (std::optional<TimeRange>& selectionOut, TimePosition& insertionOut)
+{
+    if (undoStack.empty())
+        return false;
+
+    applyingUndo = true;
+
+    // Swapping leaves the current buffers in the popped state, which is kept for the next
+    // pushUndoState() to fill rather than freed.
+    auto& state = undoStack.back();
+
+    std::swap (segments, state.segments);
+    std::swap (clipboard, state.clipboard);
+    std::swap (markers, state.markers);
+    selectionOut = state.selection;
+    insertionOut = state.insertionPoint;
+
+    // Tracks added since the state was pushed go away again; ones removed since (by loading
+    // another file) come back.
+    while (extraTracks.size() > state.extraTracks.size())
+        removeExtraTrack (extraTracks.size() - 1);
+
+    for (size_t i = extraTracks.size(); i < state.extraTracks.size(); ++i)
+        if (! createExtraTrack (state.extraTracks[i].source, state.extraTracks[i].linked))
+            break;
+
+    for (size_t i = 0; i < std::min (extraTracks.size(), state.extraTracks.size()); ++i)
+    {
+        extraTracks[i].linked = state.extraTracks[i].linked;
+        std::swap (extraTracks[i].segments, state.extraTracks[i].segments);
+        std::swap (extraTracks[i].clipboard, state.extraTracks[i].clipboard);
+    }
+
+    if (loadedFile != state.loadedFile)
+        fingerprintIndex.build (state.loadedFile);
+
+    loadedFile = state.loadedFile;
+    loadedFileLength = state.loadedFileLength;
+    spareUndoState = std::move (state);
+    undoStack.pop_back();
+
+    // rebuildTrack() only replaces the thumbnail if the undo brought back a different file.
+    if (! loadedFile.existsAsFile())
+    {
+        thumbnail.reset();
+        thumbnailFile = juce::File();
+    }
+
+    rebuildTrack();
+    applyingUndo = false;
+    return true;
+}
+
+void AudioEngine::beginBatch (const std::optional<TimeRange>& selection)
+{
+    if (batchDepth == 0)
+    {
+        pushUndoState (selection, insertionPoint);
+        rebuildPending = false;
+    }
+
+    ++batchDepth;
+}
+
+void AudioEngine::endBatch (bool commit)
+{
+    jassert (batchDepth > 0);
+
+    if (batchDepth == 0 || --batchDepth > 0)
+        return;
+
+    if (commit)
+    {
+        if (std::exchange (rebuildPending, false))
+            rebuildTrack();
+
+        return;
+    }
+
+    // Restoring the state pushed by beginBatch() rebuilds the track as it was.
+    rebuildPending = false;
+    std::optional<TimeRange> selection;
+    TimePosition insertion;
+
+    if (undo (selection, insertion))
+        insertionPoint = insertion;
+}
+
+bool AudioEngine::normaliseRange (TimeRange range, juce::String& statusOut)
+{
+    if (edit == nullptr || track == nullptr || segments.empty())
+    {
+        statusOut = "Normalise failed: no audio";
+        return false;
+    }
+
+    // Normalising frees the playback context, which a take reads its timing from.
+    if (takeRecorder.isRecording())
+    {
+        statusOut = "Stop recording before normalising";
+        return false;
+    }
+
+    // The effect goes on the clip, so edits earlier in a batch have to be built first.
+    if (std::exchange (rebuildPending, false))
+    {
+        const auto depth = std::exchange (batchDepth, 0);
+        rebuildTrack();
+        batchDepth = depth;
+    }
+
+    auto& transport = edit->getTransport();
+    if (transport.isPlaying())
+        transport.stop (false, true);
+    if (transport.isPlayContextActive())
+        transport.freePlaybackContext();
+
+    edit->flushState();
+
+    te::AudioClipBase* regionClip = nullptr;
+
+    
+    DBG("AE:norm clips at start " << track->getClips().size());
+
+
+    for (auto* c : track->getClips())
+    {
+        if (auto* ac = dynamic_cast<te::AudioClipBase*> (c))
+        {
+            auto pos = ac->getPosition().time;
+            if (pos.getStart() <= range.getStart() && pos.getEnd() >= range.getEnd())
+            {
+                regionClip = ac;
+                break;
+            }
+        }
+    }
+
+    if (regionClip == nullptr)
+    {
+        statusOut = "Normalise failed: no clip";
+        return false;
+    }
+
+    auto* clipTrack = dynamic_cast<te::ClipTrack*> (regionClip->getTrack());
+    if (clipTrack == nullptr)
+    {
+        statusOut = "Normalise failed: track";
+        return false;
+    }
+
+    const auto clipRange = regionClip->getPosition().time;
+    if (range.getEnd() < clipRange.getEnd())
+        clipTrack->splitClip (*regionClip, range.getEnd());
+    if (range.getStart() > clipRange.getStart())
+        clipTrack->splitClip (*regionClip, range.getStart());
+
+    regionClip = nullptr;
+    for (auto* c : clipTrack->getClips())
+    {
+        if (auto* ac = dynamic_cast<te::AudioClipBase*> (c))
+        {
+            if (ac->getPosition().time == range)
+            {
+                regionClip = ac;
+                break;
+            }
+        }
+    }
+
+    if (regionClip == nullptr)
+    {
+        statusOut = "Normalise failed: region";
+        return false;
+    }
+
+    regionClip->enableEffects (true, false);
+    if (regionClip->getClipEffects() != nullptr)
+    {
+        auto vt = te::ClipEffect::create (te::ClipEffect::EffectType::normalise);
+
+        regionClip->addEffect (vt);
+        regionClip->setEffectsVisible (true);
+        statusOut = "Normalise effect added";
+        updateDisplayThumbnailFromTrack();
+        return true;
+    }
+
+    statusOut = "Normalise failed: effects";
+    return false;
+}
+
+std::vector<IAudioEngine::SimilarRegion> AudioEngine::findSimilarRegions (TimeRange selection) const
+{
+    // Consolidated runs are searched as the source they came from.
+    auto& sourceSegs = getSourceSegments();
+    std::vector<juce::Range<double>> query;
+    const juce::Range<double> selected (selection.getStart().inSeconds(), selection.getEnd().inSeconds());
+    double pos = 0.0;
+
+    for (auto& seg : sourceSegs)
+    {
+        const auto segLength = seg.length.inSeconds();
+        const auto intersection = juce::Range<double> (pos, pos + segLength).getIntersectionWith (selected);
+
+        // Only the loaded file is fingerprinted; recorded takes aren't searched.
+        if (! intersection.isEmpty() && seg.source == loadedFile)
+        {
+            const auto sourceStart = seg.sourceOffset.inSeconds() + (intersection.getStart() - pos);
+            query.push_back ({ sourceStart, sourceStart + intersection.getLength() });
+        }
+
+        pos += segLength;
+    }
+
+    std::vector<SimilarRegion> results;
+
+    // A matching stretch of source may appear several times in the timeline, or be split by
+    // edits; report each contiguous timeline piece.
+    for (auto& match : fingerprintIndex.findMatches (query))
+    {
+        pos = 0.0;
+        std::optional<juce::Range<double>> current;
+
+        auto flush = [&]
+        {
+            if (current.has_value())
+                results.push_back ({ current->getStart() * 1000.0, current->getEnd() * 1000.0, match.votes });
+
+            current.reset();
+        };
+
+        for (auto& seg : sourceSegs)
+        {
+            const auto segLength = seg.length.inSeconds();
+            const auto offset = seg.sourceOffset.inSeconds();
+            const auto intersection = juce::Range<double> (offset, offset + segLength).getIntersectionWith (match.sourceSeconds);
+
+            if (intersection.isEmpty() || seg.source != loadedFile)
+            {
+                flush();
+            }
+            else
+            {
+                const juce::Range<double> timeline (pos + intersection.getStart() - offset, pos + intersection.getEnd() - offset);
+
+                if (current.has_value() && std::abs (current->getEnd() - timeline.getStart()) < 1.0e-6)
+                {
+                    current = current->withEnd (timeline.getEnd());
+                }
+                else
+                {
+                    flush();
+                    current = timeline;
+                }
+            }
+
+            pos += segLength;
+        }
+
+        flush();
+    }
+
+    return results;
+}
+
+bool AudioEngine::startScrub (TimePosition from, double speed)
+{
+    if (edit == nullptr || ! editListFile.existsAsFile())
+        return false;
+
+    initialiseAudioDevice();
+    stopLoopPreview();
+
+    auto& transport = edit->getTransport();
+    if (transport.isPlaying())
+        transport.stop (false, true);
+
+    std::unique_ptr<juce::AudioFormatReader> reader (engine.getAudioFileFormatManager().readFormatManager.createReaderFor (editListFile));
+    if (reader == nullptr)
+        return false;
+
+    scrubEngine.start (std::move (reader), clampToTimeline (from).inSeconds(), speed);
+    return scrubEngine.isActive();
+}
+
+void AudioEngine::setScrubSpeed (double speed)
+{
+    scrubEngine.setSpeed (speed);
+}
+
+IAudioEngine::TimePosition AudioEngine::stopScrub()
+{
+    if (! scrubEngine.isActive())
+        return insertionPoint;
+
+    setInsertionPoint (TimePosition::fromSeconds (scrubEngine.stop()));
+    return insertionPoint;
+}
+
+bool AudioEngine::isScrubbing() const
+{
+    return scrubEngine.isActive();
+}
+
+IAudioEngine::TimePosition AudioEngine::getScrubPosition() const
+{
+    return scrubEngine.isActive() ? TimePosition::fromSeconds (scrubEngine.getPositionSeconds()) : insertionPoint;
+}
+
+bool AudioEngine::startRecording (double preRollSeconds, juce::String& statusOut)
+{
+    if (edit == nullptr || ! loadedFile.existsAsFile())
+    {
+        statusOut = "Load a file before recording";
+        return false;
+    }
+
+    if (takeRecorder.isRecording())
+        return true;
+
+    stopScrub();
+    enableAllInputChannels();
+
+    const auto deviceRate = takeRecorder.getDeviceSampleRate();
+    if (deviceRate <= 0.0)
+    {
+        statusOut = "No audio input available";
+        return false;
+    }
+
+    te::AudioFile source (engine, loadedFile);
+    const auto numChannels = juce::jlimit (1, 2, source.getNumChannels());
+    auto takeFile = engine.getPropertyStorage().getAppPrefsFolder().getChildFile ("Takes")
+                      .getNonexistentChildFile ("Take " + juce::Time::getCurrentTime().formatted ("%Y-%m-%d %H-%M-%S"), ".wav", false);
+
+    // Playback starts preRoll before the insertion point; the take is trimmed to what comes after it when it's inserted.
+    const auto preRoll = juce::jlimit (0.0, insertionPoint.inSeconds(), preRollSeconds);
+    recordInsertion = insertionPoint;
+    recordPlayStart = TimePosition::fromSeconds (insertionPoint.inSeconds() - preRoll);
+
+    stopLoopPreview();
+
+    auto& transport = edit->getTransport();
+    transport.ensureContextAllocated();
+
+    // Called on the audio thread. The node play head is lock-free, and the context stays
+    // allocated until the take stops: normalising and exporting are refused while recording,
+    // and replacing the edit stops the take first.
+    auto playPosition = [context = edit->getCurrentPlaybackContext()]() -> double
+    {
+        auto* playHead = context != nullptr ? context->getNodePlayHead() : nullptr;
+
+        if (playHead == nullptr || ! playHead->isPlaying())
+            return -1.0;
+
+        return (double) playHead->getPosition() / context->getSampleRate();
+    };
+
+    if (! takeRecorder.start (takeFile, numChannels, std::move (playPosition)))
+    {
+        statusOut = "Couldn't create " + takeFile.getFullPathName();
+        return false;
+    }
+
+    transport.setPosition (recordPlayStart);
+    transport.play (false);
+
+    currentTakeFile = takeFile;
+    statusOut = preRoll > 0.0 ? "Recording after " + juce::String (preRoll, 1) + "s pre-roll..." : "Recording...";
+    return true;
+}
+
+bool AudioEngine::stopRecording (juce::String& statusOut, std::function<void (bool, const juce::String&)> onComplete)
+{
+    if (! takeRecorder.isRecording())
+        return false;
+
+    const auto stats = takeRecorder.stop();
+    edit->getTransport().stop (false, true);
+
+    auto take = currentTakeFile;
+    currentTakeFile = juce::File();
+
+    if (stats.samplesRecorded <= 0)
+    {
+        take.deleteFile();
+        statusOut = "Nothing was recorded";
+        return false;
+    }
+
+    // Whatever the take caught before the insertion point (the pre-roll, and the latency it
+    // arrived late by) stays in the file and is skipped by the inserted fragment.
+    const auto takeStart = stats.playbackStarted ? stats.startPosition : recordPlayStart.inSeconds();
+    const auto skip = TimeDuration::fromSeconds (std::max (0.0, recordInsertion.inSeconds() - takeStart));
+    const auto deviceRate = takeRecorder.getDeviceSampleRate();
+    const auto sourceRate = te::AudioFile (engine, loadedFile).getSampleRate();
+
+    loadPool.addJob ([this, take, skip, deviceRate, sourceRate, stats, onComplete, insertion = recordInsertion, source = loadedFile,
+                      weakThis = juce::WeakReference<AudioEngine> (this)]
+    {
+        // Every source in an edit list has to share a rate, so a take recorded at a different
+        // device rate is converted to the loaded file's rate first.
+        auto finishedTake = take;
+        bool converted = true;
+
+        if (std::abs (deviceRate - sourceRate) > 0.5)
+        {
+            auto convertedTake = take.getSiblingFile (take.getFileNameWithoutExtension() + " " + juce::String ((int) sourceRate) + ".wav");
+            juce::WavAudioFormat wav;
+            std::atomic<float> progress { 0.0f };
+
+            converted = SampleRateConverter::convertFile (take, convertedTake, wav, sourceRate, 32, 0, false,
+                                                          SampleRateConverter::Quality::high, progress);
+
+            if (converted)
+            {
+                take.deleteFile();
+                finishedTake = convertedTake;
+            }
+        }
+
+        const auto takeLength = converted ? TimeDuration::fromSeconds (te::AudioFile (engine, finishedTake).getLength()) : TimeDuration();
+
+        juce::MessageManager::callAsync ([weakThis, finishedTake, skip, sourceRate, stats, onComplete, insertion, source, converted, takeLength]
+        {
+            if (weakThis == nullptr)
+                return;
+
+            auto& self = *weakThis;
+            const auto length = takeLength - skip;
+            juce::String status;
+            bool inserted = false;
+
+            if (! converted)
+            {
+                status = "Couldn't convert the take to " + juce::String ((int) sourceRate) + " Hz; it was kept at " + finishedTake.getFullPathName();
+            }
+            else if (self.edit == nullptr || self.loadedFile != source)
+            {
+                status = "The file was closed while the take was finishing; it was kept at " + finishedTake.getFullPathName();
+            }
+            else if (length <= 0s)
+            {
+                finishedTake.deleteFile();
+                status = "Nothing was recorded after the insertion point";
+            }
+            else
+            {
+                self.pushUndoState (std::nullopt, insertion);
+                self.adoptGeneratedFile (finishedTake);
+
+                // The take is inserted like a paste; linked tracks get the same length of silence so they stay aligned.
+                self.insertIntoTrack (self.segments, insertion, ClipboardFragment { 0s, length, skip, finishedTake });
+                insertIntoMarkers (self.markers, insertion, length);
+
+                for (auto& extra : self.extraTracks)
+                    if (extra.linked)
+                        self.insertIntoTrack (extra.segments, insertion, ClipboardFragment { 0s, length, 0s, juce::File() });
+
+                self.rebuildTrack();
+                self.setInsertionPoint (insertion + length);
+                inserted = true;
+
+                status = "Recorded " + juce::String (length.inSeconds(), 1) + "s";
+                if (stats.dropouts > 0)
+                    status << " (" << stats.dropouts << " dropouts, " << stats.samplesDropped << " samples lost)";
+            }
+
+            DBG ("Recording: " << stats.samplesRecorded << " samples written, " << stats.samplesDropped
+                 << " dropped in " << stats.dropouts << " blocks, " << skip.inSeconds() << " s skipped");
+
+            if (onComplete != nullptr)
+                onComplete (inserted, status);
+        });
+    });
+
+    statusOut = "Finishing the take...";
+    return true;
+}
+
+bool AudioEngine::isRecording() const
+{
+    return takeRecorder.isRecording();
+}
+
+TakeRecorder::Stats AudioEngine::getRecordingStats() const
+{
+    return takeRecorder.getStats();
+}
+
+bool AudioEngine::startLoopPreview (TimeRange range)
+{
+    range = range.getIntersectionWith ({ 0_tp, 0_tp + getTotalLength() });
+
+    if (edit == nullptr || range.isEmpty())
+        return false;
+
+    initialiseAudioDevice();
+    stopScrub();
+    stopLoopPreview();
+
+    auto& transport = edit->getTransport();
+    if (transport.isPlaying())
+        transport.stop (false, true);
+
+    // Loops too long to hold in memory play live through the transport instead.
+    if (range.getLength().inSeconds() > LoopPreview::maxLoopSeconds)
+    {
+        transportLoopRange = range;
+        transport.setLoopRange (range);
+        transport.looping = true;
+        transport.setPosition (range.getStart());
+        transport.play (false);
+        return true;
+    }
+
+    return loopPreview.start (*edit, range, [] (bool renderReady)
+    {
+        DBG ("Loop preview " << (renderReady ? "ready" : "render failed"));
+    });
+}
+
+void AudioEngine::stopLoopPreview()
+{
+    loopPreview.stop();
+
+    if (! transportLoopRange.has_value())
+        return;
+
+    transportLoopRange.reset();
+
+    if (edit != nullptr)
+    {
+        auto& transport = edit->getTransport();
+        transport.stop (false, true);
+        transport.looping = false;
+        transport.setLoopRange ({ 0_tp, 0_tp + getTotalLength() });
+    }
+}
+
+bool AudioEngine::isLoopPreviewing() const
+{
+    return loopPreview.isActive() || transportLoopRange.has_value();
+}
+
+const PerformanceMonitor::Snapshot& AudioEngine::getPerformanceSnapshot() const
+{
+    return performanceMonitor.getSnapshot();
+}
+
+void AudioEngine::startPluginScan()
+{
+    if (pluginScanner == nullptr)
+    {
+        auto& pluginManager = engine.getPluginManager();
+        pluginScanner = std::make_unique<PluginScanner> (pluginManager.pluginFormatManager, pluginManager.knownPluginList,
+                                                         engine.getPropertyStorage().getAppCacheFolder().getChildFile ("PluginScanCache.xml"));
+    }
+
+    pluginScanner->startScan ([] (int numScanned)
+    {
+        DBG ("Plugin scan finished: " << numScanned << " binaries scanned");
+    });
+}
+
+bool AudioEngine::isScanningPlugins() const
+{
+    return pluginScanner != nullptr && pluginScanner->isScanning();
+}
+
+void AudioEngine::rebuildTrack()
+{
+    if (batchDepth > 0)
+    {
+        rebuildPending = true;
+        return;
+    }
+
+    coalesceSegments (segments);
+    for (auto& extra : extraTracks)
+        coalesceSegments (extra.segments);
+
+    if (! consolidatedOrigins.empty())
+        expandConsolidated (segments, consolidatedOrigins, sourceSegments);
+
+    if (edit == nullptr || track == nullptr || ! loadedFile.existsAsFile())
+        return;
+
+    // What follows allocates inside tracktion and for the edit-list files, so the allocation
+    // count reports it apart from the segment edits above.
+    const AllocationCounter::ScopedExclusion excludeRebuild;
+
+    // Every track is rebuilt in one pass, so an edit that touches linked tracks still costs
+    // a single graph rebuild. Old edit-list files are only dropped once nothing uses them.
+    juce::Array<juce::File> previousFiles { editListFile };
+    for (auto& extra : extraTracks)
+        previousFiles.add (extra.editListFile);
+
+    // Proxies the new edit lists read are pinned before they're written, so the proxy
+    // cache can't evict one out from under a playing track.
+    juce::Array<juce::File> liveSources { loadedFile };
+
+    for (auto& seg : segments)
+        liveSources.addIfNotAlreadyThere (seg.source);
+
+    for (auto& extra : extraTracks)
+        for (auto& seg : extra.segments)
+            liveSources.addIfNotAlreadyThere (seg.source);
+
+    proxyCache.setInUse (liveSources);
+
+    editListFile = rebuildClip (*track, loadedFile, segments);
+    auto timelineEnd = TimePosition::fromSeconds (getTotalLength().inSeconds());
+
+    for (auto& extra : extraTracks)
+    {
+        extra.editListFile = rebuildClip (*extra.track, extra.source, extra.segments);
+        timelineEnd = std::max (timelineEnd, TimePosition::fromSeconds (getLength (extra.segments).inSeconds()));
+    }
+
+    for (auto& previous : previousFiles)
+    {
+        const bool stillUsed = previous == editListFile
+                                || std::any_of (extraTracks.begin(), extraTracks.end(),
+                                                [&] (const ExtraTrack& extra) { return extra.editListFile == previous; });
+
+        if (! stillUsed && previous.existsAsFile())
+        {
+            engine.getAudioFileManager().releaseFile (te::AudioFile (engine, previous));
+            previous.deleteFile();
+        }
+    }
+
+    ++timelineVersion;
+    performanceMonitor.noteGraphRebuild ("timeline " + juce::String (timelineVersion) + ", "
+                                         + juce::String ((int) segments.size()) + " segments, "
+                                         + juce::String ((int) extraTracks.size() + 1) + " tracks");
+    initialiseAudioDevice();
+    edit->getTransport().setLoopRange (transportLoopRange.value_or (TimeRange { 0_tp, timelineEnd }));
+    edit->getTransport().ensureContextAllocated();
+    updateDisplayThumbnailFromTrack();
+    deleteUnreferencedFiles();
+}
+
+void AudioEngine::adoptGeneratedFile (const juce::File& file)
+{
+    generatedFiles.insert (file);
+}
+
+bool AudioEngine::isGeneratedAudio (const juce::File& file) const
+{
+    const auto folder = file.getParentDirectory();
+    const auto prefs = engine.getPropertyStorage().getAppPrefsFolder();
+
+    return folder.getParentDirectory() == prefs
+            && juce::StringArray { "Takes", "Stretched", "Pasted", "Consolidated" }.contains (folder.getFileName());
+}
+
+void AudioEngine::deleteUnreferencedFiles()
+{
+    if (generatedFiles.empty())
+        return;
+
+    std::set<juce::File> referenced;
+
+    auto addTrack = [&referenced] (const std::vector<Segment>& trackSegments, const std::vector<ClipboardFragment>& trackClipboard)
+    {
+        for (auto& seg : trackSegments)
+            referenced.insert (seg.source);
+
+        for (auto& fragment : trackClipboard)
+            referenced.insert (fragment.source);
+    };
+
+    addTrack (segments, clipboard);
+
+    for (auto& extra : extraTracks)
+        addTrack (extra.segments, extra.clipboard);
+
+    for (auto& state : undoStack)
+    {
+        addTrack (state.segments, state.clipboard);
+
+        for (auto& extra : state.extraTracks)
+            addTrack (extra.segments, extra.clipboard);
+    }
+
+    // What this instance last published may still be pasted by another one.
+    for (auto& fragment : sharedFragments)
+        referenced.insert (fragment.source);
+
+    // The pieces a live consolidated file stands for are still needed to analyse it.
+    for (auto& [file, origins] : consolidatedOrigins)
+        if (referenced.count (file) > 0)
+            for (auto& origin : origins)
+                referenced.insert (origin.source);
 
-    segments.push_back ({ loadedFileLength, 0s });
+    for (auto it = generatedFiles.begin(); it != generatedFiles.end();)
+    {
+        if (referenced.count (*it) > 0)
+        {
+            ++it;
+            continue;
+        }
 
-    // thumbnail = std::make_unique<te::SmartThumbnail> (engine, audioFile, thumbnailComponent, nullptr);
-    rebuildTrack();
-    statusOut = "Loaded " + file.getFileName();
-    return true;
-}
+        engine.getAudioFileManager().releaseFile (te::AudioFile (engine, *it));
 
-const std::vector<IAudioEngine::Segment>& AudioEngine::getSegments() const
-{
-    return segments;
-}
+        // A file that can't be deleted yet (still open somewhere) is tried again next time.
+        if (it->existsAsFile() && ! it->deleteFile())
+        {
+            ++it;
+            continue;
+        }
 
-IAudioEngine::TimeDuration AudioEngine::getTotalLength() const
-{
-    TimeDuration total { 0s };
-    for (auto& seg : segments)
-        total = total + seg.length;
-    return total;
+        consolidatedOrigins.erase (*it);
+        it = generatedFiles.erase (it);
+    }
 }
 
-te::SmartThumbnail* AudioEngine::getThumbnail() const
+juce::File AudioEngine::rebuildClip (te::AudioTrack& target, const juce::File& source, const std::vector<Segment>& trackSegments)
 {
-    return thumbnail.get();
-}
+    EngineHelpers::removeAllClips (target);
 
-juce::File AudioEngine::getDisplayFile() const
-{
-    return displayFile;
-}
+    const auto end = TimePosition::fromSeconds (getLength (trackSegments).inSeconds());
 
-void AudioEngine::setInsertionPoint (TimePosition pos)
-{
-    insertionPoint = clampToTimeline (pos);
+    // The whole segment list plays as one clip reading a virtual edit-list source,
+    // so the graph doesn't grow with the number of edits.
+    auto file = writeEditListFile (source, trackSegments);
 
-    if (edit != nullptr)
-        edit->getTransport().setPosition (insertionPoint);
-}
+    if (end > 0_tp && file.existsAsFile())
+        target.insertWaveClip (source.getFileNameWithoutExtension(), file, { { 0_tp, end }, 0s }, false);
 
-IAudioEngine::TimePosition AudioEngine::getInsertionPoint() const
-{
-    return insertionPoint;
+    return file;
 }
 
-bool AudioEngine::copySelection (TimeRange selection)
+juce::File AudioEngine::writeEditListFile (const juce::File& source, const std::vector<Segment>& trackSegments)
 {
-    clipboard.clear();
+    te::AudioFile audioFile (engine, source);
+    const auto sampleRate = audioFile.getSampleRate();
 
-    auto total = getTotalLength();
-    auto clamped = selection.getIntersectionWith ({ 0_tp, TimePosition::fromSeconds (total.inSeconds()) });
+    if (sampleRate <= 0.0)
+        return {};
 
-    auto pos = 0_tp;
-    for (auto& seg : segments)
-    {
-        const auto segRange = TimeRange { pos, pos + seg.length };
-        const auto intersection = segRange.getIntersectionWith (clamped);
+    auto toSamples = [sampleRate] (TimeDuration d) { return (juce::int64) std::llround (d.inSeconds() * sampleRate); };
 
-        if (! intersection.isEmpty())
+    juce::Array<juce::File> sources { source };
+    std::vector<EditListAudioFormatReader::Range> ranges;
+    ranges.reserve (trackSegments.size());
+
+    for (auto& seg : trackSegments)
+    {
+        // A segment without a source is silence (e.g. padding a linked track around a take).
+        auto sourceIndex = seg.source == juce::File() ? EditListAudioFormatReader::silenceIndex : sources.indexOf (seg.source);
+        if (sourceIndex < 0 && seg.source != juce::File())
         {
-            auto relStart = intersection.getStart() - clamped.getStart();
-            auto offset = seg.sourceOffset + (intersection.getStart() - segRange.getStart());
-            clipboard.push_back ({ relStart, intersection.getLength(), offset });
+            sourceIndex = sources.size();
+            sources.add (seg.source);
         }
 
-        pos = pos + seg.length;
+        ranges.push_back ({ toSamples (seg.sourceOffset), toSamples (seg.length), sourceIndex });
+    }
+
+    // Named by content so identical segment lists (e.g. after undo) map to the same file
+    // and nothing cached against an older list can be read by mistake.
+    // Compressed sources play from their decoded proxies once those are ready.
+    for (auto& f : sources)
+        f = proxyCache.resolve (f);
+
+    auto description = EditListAudioFormat::createDescription (sources, ranges);
+    auto file = editListDirectory.directory
+                  .getChildFile (juce::String::toHexString (description.hashCode64()))
+                  .withFileExtension (EditListAudioFormat::fileExtension);
+
+    if (! file.existsAsFile())
+    {
+        file.getParentDirectory().createDirectory();
+        if (! file.replaceWithText (description))
+            return {};
     }
 
-    return ! clipboard.empty();
+    return file;
 }
 
-bool AudioEngine::cutSelection (TimeRange selection)
+bool AudioEngine::stretchSelection (TimeRange selection, double lengthRatio, float semitones,
+                                    std::function<void (bool, const juce::String&)> onComplete)
 {
-    if (segments.empty())
+    selection = selection.getIntersectionWith ({ 0_tp, TimePosition::fromSeconds (getTotalLength().inSeconds()) });
+
+    if (edit == nullptr || selection.isEmpty() || lengthRatio <= 0.0 || ! editListFile.existsAsFile() || stretchRenderer.isRendering())
         return false;
 
-    std::vector<Segment> newSegments;
-    auto sel = selection;
-    auto pos = 0_tp;
+    const auto sampleRate = te::AudioFile (engine, loadedFile).getSampleRate();
+    if (sampleRate <= 0.0)
+        return false;
 
-    for (auto& seg : segments)
+    TimeStretchRenderer::Request request;
+    request.timeline = editListFile;
+    request.startSample = (juce::int64) std::llround (selection.getStart().inSeconds() * sampleRate);
+    request.numSamples = (juce::int64) std::llround (selection.getLength().inSeconds() * sampleRate);
+    request.lengthRatio = lengthRatio;
+    request.semitones = semitones;
+
+    // Edit lists are named by their content, so this identifies the selected audio exactly;
+    // their folder is this instance's, so the render is too.
+    juce::String description;
+    description << "stretch|" << editListFile.getFullPathName() << "|" << request.startSample << "|" << request.numSamples
+                << "|" << lengthRatio << "|" << semitones;
+    request.destFile = engine.getPropertyStorage().getAppPrefsFolder().getChildFile ("Stretched")
+                         .getChildFile (RenderCache::createKey (description) + ".wav");
+
+    const auto version = timelineVersion;
+    auto finish = [this, selection, version, destFile = request.destFile, onComplete] (bool succeeded)
     {
-        const auto segRange = TimeRange { pos, pos + seg.length };
-        const auto intersection = segRange.getIntersectionWith (sel);
+        juce::String status;
 
-        if (intersection.isEmpty())
+        if (! succeeded)
+        {
+            status = "Time stretch failed";
+        }
+        else if (version != timelineVersion)
         {
-            newSegments.push_back (seg);
+            status = "The timeline changed while stretching; try again";
+            succeeded = false;
         }
         else
         {
-            auto preLen  = intersection.getStart() - segRange.getStart();
-            auto postLen = segRange.getEnd() - intersection.getEnd();
-
-            if (preLen > 0s)
-                newSegments.push_back ({ preLen, seg.sourceOffset });
-
-            if (postLen > 0s)
-            {
-                auto newOffset = seg.sourceOffset + (seg.length - postLen);
-                newSegments.push_back ({ postLen, newOffset });
-            }
+            adoptGeneratedFile (destFile);
+            spliceRender (selection, destFile);
+            status = "Stretched selection to " + juce::String (te::AudioFile (engine, destFile).getLength(), 2) + "s";
         }
 
-        pos = pos + seg.length;
+        if (onComplete != nullptr)
+            onComplete (succeeded, status);
+    };
+
+    if (request.destFile.existsAsFile())
+    {
+        finish (true);
+        return true;
     }
 
-    segments = std::move (newSegments);
-    rebuildTrack();
-    return true;
+    return stretchRenderer.render (request, std::move (finish));
 }
 
-bool AudioEngine::pasteClipboard (TimePosition insertAt)
+bool AudioEngine::isStretching() const
 {
-    if (clipboard.empty())
-        return false;
+    return stretchRenderer.isRendering();
+}
 
-    auto insertion = clampToTimeline (insertAt);
-    std::vector<Segment> newSegments;
+bool AudioEngine::consolidateFragments (std::function<void (bool, const juce::String&)> onComplete)
+{
+    if (edit == nullptr || consolidatePending || ! editListFile.existsAsFile())
+        return false;
 
-    auto sortedClipboard = clipboard;
-    std::sort (sortedClipboard.begin(), sortedClipboard.end(),
-               [] (const ClipboardFragment& a, const ClipboardFragment& b)
-               {
-                   return a.relativeStart < b.relativeStart;
-               });
+    const auto sampleRate = te::AudioFile (engine, loadedFile).getSampleRate();
+    if (sampleRate <= 0.0)
+        return false;
 
-    auto appendClipboard = [&]
+    struct Run
     {
-        for (auto& frag : sortedClipboard)
-            newSegments.push_back ({ frag.length, frag.sourceOffset });
+        size_t firstSegment = 0, numSegments = 0;
+        juce::int64 startSample = 0, numSamples = 0;
+        juce::File dest;
     };
 
-    auto pos = 0_tp;
-    bool inserted = false;
+    // Positions are counted in samples the same way writeEditListFile() does, so each run
+    // reads exactly the samples its segments play.
+    auto toSamples = [sampleRate] (TimeDuration d) { return (juce::int64) std::llround (d.inSeconds() * sampleRate); };
+    auto dir = engine.getPropertyStorage().getAppPrefsFolder().getChildFile ("Consolidated");
+    std::vector<Run> runs;
+    Run current;
+    juce::int64 pos = 0;
 
-    for (auto& seg : segments)
+    auto closeRun = [&]
     {
-        const auto segRange = TimeRange { pos, pos + seg.length };
-
-        if (! inserted && insertion < segRange.getEnd())
+        if (current.numSegments >= (size_t) minFragmentRun)
         {
-            auto preLen = insertion - segRange.getStart();
-            auto postLen = segRange.getEnd() - insertion;
+            juce::String description;
+            description << "consolidate|" << editListFile.getFullPathName() << "|" << current.startSample << "|" << current.numSamples;
+            current.dest = dir.getChildFile (RenderCache::createKey (description) + ".wav");
+            runs.push_back (current);
+        }
 
-            if (preLen > 0s)
-                newSegments.push_back ({ preLen, seg.sourceOffset });
+        current = {};
+    };
 
-            appendClipboard();
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        const auto numSamples = toSamples (segments[i].length);
 
-            if (postLen > 0s)
+        if (segments[i].length.inSeconds() < maxFragmentSeconds)
+        {
+            if (current.numSegments == 0)
             {
-                auto newOffset = seg.sourceOffset + (seg.length - postLen);
-                newSegments.push_back ({ postLen, newOffset });
+                current.firstSegment = i;
+                current.startSample = pos;
             }
 
-            inserted = true;
+            ++current.numSegments;
+            current.numSamples += numSamples;
         }
         else
         {
-            newSegments.push_back (seg);
+            closeRun();
         }
 
-        pos = pos + seg.length;
+        pos += numSamples;
     }
 
-    if (! inserted)
-        appendClipboard();
+    closeRun();
+
+    if (runs.empty())
+        return false;
+
+    consolidatePending = true;
+    const auto version = timelineVersion;
+
+    loadPool.addJob ([this, runs, version, onComplete, timeline = editListFile, weakThis = juce::WeakReference<AudioEngine> (this)]
+    {
+        auto& formatManager = engine.getAudioFileFormatManager().readFormatManager;
+        bool rendered = true;
+
+        for (auto& run : runs)
+            if (! run.dest.existsAsFile())
+                rendered = writeTimelineRange (formatManager, timeline, run.startSample, run.numSamples, run.dest) && rendered;
+
+        juce::MessageManager::callAsync ([weakThis, runs, version, onComplete, rendered]
+        {
+            if (weakThis == nullptr)
+                return;
+
+            auto& self = *weakThis;
+            self.consolidatePending = false;
+            juce::String status;
+            bool succeeded = false;
+
+            if (! rendered)
+            {
+                status = "Couldn't consolidate the fragmented regions";
+            }
+            else if (version != self.timelineVersion)
+            {
+                status = "The timeline changed while consolidating; try again";
+            }
+            else
+            {
+                // Swapped in as one undo step; working from the back keeps earlier indices valid.
+                self.pushUndoState (std::nullopt, self.insertionPoint);
+                size_t numReplaced = 0;
+
+                for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+                {
+                    auto first = self.segments.begin() + (std::ptrdiff_t) run->firstSegment;
+
+                    // Remembered in terms of the original sources, even where a run includes
+                    // pieces of an earlier consolidation.
+                    const std::vector<Segment> replaced (first, first + (std::ptrdiff_t) run->numSegments);
+                    std::vector<Segment> origins;
+                    expandConsolidated (replaced, self.consolidatedOrigins, origins);
+                    self.consolidatedOrigins[run->dest] = std::move (origins);
+                    self.adoptGeneratedFile (run->dest);
+
+                    first = self.segments.erase (first, first + (std::ptrdiff_t) run->numSegments);
+                    self.segments.insert (first, { TimeDuration::fromSeconds (te::AudioFile (self.engine, run->dest).getLength()),
+                                                   0s, run->dest });
+                    numReplaced += run->numSegments;
+                }
+
+                self.rebuildTrack();
+                succeeded = true;
+                status = "Consolidated " + juce::String ((int) numReplaced) + " segments into " + juce::String ((int) runs.size());
+            }
+
+            if (onComplete != nullptr)
+                onComplete (succeeded, status);
+        });
+    });
 
-    segments = std::move (newSegments);
-    rebuildTrack();
     return true;
 }
 
-bool AudioEngine::hasClipboard() const
+bool AudioEngine::isConsolidating() const
 {
-    return ! clipboard.empty();
+    return consolidatePending;
 }
 
-void AudioEngine::pushUndoState (const std::optional<TimeRange>& selection, TimePosition insertion)
+void AudioEngine::spliceRender (TimeRange selection, const juce::File& render)
 {
-    if (applyingUndo)
-        return;
+    const auto newLength = TimeDuration::fromSeconds (te::AudioFile (engine, render).getLength());
 
-    UndoState state;
-    state.segments = segments;
-    state.clipboard = clipboard;
-    state.selection = selection;
-    state.insertionPoint = insertion;
-    state.loadedFile = loadedFile;
-    state.loadedFileLength = loadedFileLength;
+    pushUndoState (selection, selection.getStart());
+    cutTrack (segments, selection);
+    insertIntoTrack (segments, selection.getStart(), ClipboardFragment { 0s, newLength, 0s, render });
+    removeFromMarkers (markers, selection);
+    insertIntoMarkers (markers, selection.getStart(), newLength);
 
-    undoStack.push_back (std::move (state));
-    if (undoStack.size() > maxUndoHistory)
-        undoStack.erase (undoStack.begin());
+    // Linked tracks keep their own audio; they are padded with silence or trimmed at the end
+    // of the selection so that everything after it stays aligned.
+    const auto difference = newLength - selection.getLength();
+
+    for (auto& extra : extraTracks)
+    {
+        if (! extra.linked)
+            continue;
+
+        if (difference > 0s)
+            insertIntoTrack (extra.segments, selection.getEnd(), ClipboardFragment { 0s, difference, 0s, juce::File() });
+        else if (difference < 0s)
+            cutTrack (extra.segments, TimeRange { selection.getEnd() + difference, selection.getEnd() });
+    }
+
+    rebuildTrack();
 }
 
-bool AudioEngine::undo (std::optional<TimeRange>& selectionOut, TimePosition& insertionOut)
+bool AudioEngine::addTrack (const juce::File& file, bool linked, juce::String& statusOut)
 {
-    if (undoStack.empty())
+    if (edit == nullptr || segments.empty())
+    {
+        statusOut = "Load a file before adding tracks";
         return false;
+    }
 
-    applyingUndo = true;
-    auto state = std::move (undoStack.back());
-    undoStack.pop_back();
-
-    segments = std::move (state.segments);
-    clipboard = std::move (state.clipboard);
-    selectionOut = state.selection;
-    insertionOut = state.insertionPoint;
-    loadedFile = state.loadedFile;
-    loadedFileLength = state.loadedFileLength;
+    te::AudioFile audioFile (engine, file);
 
-    if (loadedFile.existsAsFile())
+    if (! audioFile.isValid())
     {
-        te::AudioFile audioFile (engine, loadedFile);
-        thumbnail = std::make_unique<te::SmartThumbnail> (engine, audioFile, thumbnailComponent, nullptr);
+        statusOut = "Unsupported audio file";
+        return false;
     }
-    else
+
+    // Undoing past this point removes the track again.
+    pushUndoState (std::nullopt, insertionPoint);
+
+    if (! createExtraTrack (file, linked))
     {
-        thumbnail.reset();
+        statusOut = "Couldn't create a track";
+        return false;
     }
 
     rebuildTrack();
-    applyingUndo = false;
+    requestProxy (file);
+    statusOut = "Added track " + file.getFileName();
     return true;
 }
 
-bool AudioEngine::normaliseRange (TimeRange range, juce::String& statusOut)
+int AudioEngine::getNumExtraTracks() const
 {
-    if (edit == nullptr || track == nullptr || segments.empty())
-    {
-        statusOut = "Normalise failed: no audio";
-        return false;
-    }
+    return (int) extraTracks.size();
+}
 
-    auto& transport = edit->getTransport();
-    if (transport.isPlaying())
-        transport.stop (false, true);
-    if (transport.isPlayContextActive())
-        transport.freePlaybackContext();
+const std::vector<IAudioEngine::Segment>& AudioEngine::getExtraTrackSegments (int index) const
+{
+    return extraTracks[(size_t) index].segments;
+}
 
-    edit->flushState();
+juce::File AudioEngine::getExtraTrackSource (int index) const
+{
+    return extraTracks[(size_t) index].source;
+}
 
-    te::AudioClipBase* regionClip = nullptr;
+bool AudioEngine::isExtraTrackLinked (int index) const
+{
+    return extraTracks[(size_t) index].linked;
+}
 
-    
-    DBG("AE:norm clips at start " << track->getClips().size());
+void AudioEngine::setExtraTrackLinked (int index, bool linked)
+{
+    extraTracks[(size_t) index].linked = linked;
+}
 
+int AudioEngine::addMarker (TimePosition position, const juce::String& name)
+{
+    Marker marker { name, clampToTimeline (position) };
 
-    for (auto* c : track->getClips())
-    {
-        if (auto* ac = dynamic_cast<te::AudioClipBase*> (c))
-        {
-            auto pos = ac->getPosition().time;
-            if (pos.getStart() <= range.getStart() && pos.getEnd() >= range.getEnd())
-            {
-                regionClip = ac;
-                break;
-            }
-        }
-    }
+    if (marker.name.isEmpty())
+        marker.name = "Marker " + juce::String ((int) markers.size() + 1);
 
-    if (regionClip == nullptr)
-    {
-        statusOut = "Normalise failed: no clip";
-        return false;
-    }
+    auto pos = std::upper_bound (markers.begin(), markers.end(), marker.position,
+                                 [] (TimePosition p, const Marker& m) { return p < m.position; });
 
-    auto* clipTrack = dynamic_cast<te::ClipTrack*> (regionClip->getTrack());
-    if (clipTrack == nullptr)
-    {
-        statusOut = "Normalise failed: track";
-        return false;
-    }
+    return (int) std::distance (markers.begin(), markers.insert (pos, std::move (marker)));
+}
 
-    const auto clipRange = regionClip->getPosition().time;
-    if (range.getEnd() < clipRange.getEnd())
-        clipTrack->splitClip (*regionClip, range.getEnd());
-    if (range.getStart() > clipRange.getStart())
-        clipTrack->splitClip (*regionClip, range.getStart());
+void AudioEngine::removeMarker (int index)
+{
+    if (juce::isPositiveAndBelow (index, (int) markers.size()))
+        markers.erase (markers.begin() + index);
+}
 
-    regionClip = nullptr;
-    for (auto* c : clipTrack->getClips())
-    {
-        if (auto* ac = dynamic_cast<te::AudioClipBase*> (c))
-        {
-            if (ac->getPosition().time == range)
-            {
-                regionClip = ac;
-                break;
-            }
-        }
-    }
+void AudioEngine::renameMarker (int index, const juce::String& name)
+{
+    if (juce::isPositiveAndBelow (index, (int) markers.size()))
+        markers[(size_t) index].name = name;
+}
 
-    if (regionClip == nullptr)
-    {
-        statusOut = "Normalise failed: region";
-        return false;
-    }
+const std::vector<IAudioEngine::Marker>& AudioEngine::getMarkers() const
+{
+    return markers;
+}
 
-    regionClip->enableEffects (true, false);
-    if (regionClip->getClipEffects() != nullptr)
+std::vector<IAudioEngine::Region> AudioEngine::getRegions() const
+{
+    std::vector<Region> regions;
+    const auto end = 0_tp + getTotalLength();
+
+    // Markers that an edit has pushed onto the same spot give empty regions, which are skipped.
+    for (size_t i = 0; i < markers.size(); ++i)
     {
-        // auto vt = te::ClipEffect::create (te::ClipEffect::EffectType::normalise);
-        auto vt = te::ClipEffect::create (te::ClipEffect::EffectType::pitchShift);
+        const auto regionEnd = i + 1 < markers.size() ? markers[i + 1].position : end;
 
-        regionClip->addEffect (vt);
-        regionClip->setEffectsVisible (true);
-        regionClip->setGainDB(20.0f);
-        statusOut = "Normalise effect added";
-        updateDisplayThumbnailFromTrack();
-        return true;
+        if (regionEnd > markers[i].position)
+            regions.push_back ({ markers[i].name, { markers[i].position, regionEnd } });
     }
 
-    statusOut = "Normalise failed: effects";
-    return false;
+    return regions;
 }
 
-void AudioEngine::rebuildTrack()
+void AudioEngine::requestProxy (const juce::File& source)
 {
-    if (edit == nullptr || track == nullptr || ! loadedFile.existsAsFile())
-        return;
+    // A finished proxy is picked up by the next edit's rebuild rather than straight away:
+    // rebuilding replaces the clips, and with them any effects (e.g. normalise) the user
+    // has applied in the meantime.
+    proxyCache.request (source, nullptr);
+}
 
-    EngineHelpers::removeAllClips (*track);
+bool AudioEngine::createExtraTrack (const juce::File& file, bool linked)
+{
+    auto* newTrack = edit != nullptr ? EngineHelpers::getOrInsertAudioTrackAt (*edit, (int) extraTracks.size() + 1) : nullptr;
+    if (newTrack == nullptr)
+        return false;
 
-    auto name = loadedFile.getFileNameWithoutExtension();
-    auto timelinePos = 0_tp;
+    ExtraTrack extra;
+    extra.track = newTrack;
+    extra.source = file;
+    extra.linked = linked;
+    extra.segments.push_back ({ TimeDuration::fromSeconds (te::AudioFile (engine, file).getLength()), 0s, file });
+    extraTracks.push_back (std::move (extra));
+    return true;
+}
 
-    for (auto& seg : segments)
+void AudioEngine::removeExtraTrack (size_t index)
+{
+    auto& extra = extraTracks[index];
+
+    if (edit != nullptr)
+        edit->deleteTrack (extra.track);
+
+    const bool sharedWithOtherTrack = extra.editListFile == editListFile
+                                       || std::any_of (extraTracks.begin(), extraTracks.end(), [&] (const ExtraTrack& other)
+                                                       { return &other != &extra && other.editListFile == extra.editListFile; });
+
+    if (extra.editListFile.existsAsFile() && ! sharedWithOtherTrack)
     {
-        te::ClipPosition pos { { timelinePos, timelinePos + seg.length }, seg.sourceOffset };
-        track->insertWaveClip (name, loadedFile, pos, false);
-        timelinePos = timelinePos + seg.length;
+        engine.getAudioFileManager().releaseFile (te::AudioFile (engine, extra.editListFile));
+        extra.editListFile.deleteFile();
     }
 
-    edit->getTransport().setLoopRange ({ 0_tp, timelinePos });
-    edit->getTransport().ensureContextAllocated();
-    updateDisplayThumbnailFromTrack();
+    extraTracks.erase (extraTracks.begin() + (std::ptrdiff_t) index);
+}
+
+void AudioEngine::removeExtraTracks()
+{
+    while (! extraTracks.empty())
+        removeExtraTrack (extraTracks.size() - 1);
 }
 
 void AudioEngine::logTrackClipDebugInfo() const
@@ -611,14 +2390,27 @@ void AudioEngine::logTrackClipDebugInfo() const
 
 void AudioEngine::updateDisplayThumbnailFromTrack()
 {
- 
+    // The thumbnail shows the source, which edits don't change, so it is only recreated
+    // when a different file is loaded. A new one scans in the background and fills in as
+    // it goes, so the waveform appears progressively rather than after the whole file.
+    if (! loadedFile.existsAsFile() || (thumbnail != nullptr && thumbnailFile == loadedFile))
+        return;
+
+    auto prefetched = std::find_if (prefetchedThumbnails.begin(), prefetchedThumbnails.end(),
+                                    [this] (const auto& t) { return t.first == loadedFile; });
 
-    if (loadedFile.existsAsFile())
+    if (prefetched != prefetchedThumbnails.end())
+    {
+        thumbnail = std::move (prefetched->second);
+        prefetchedThumbnails.erase (prefetched);
+    }
+    else
     {
-        // displayFile = loadedFile;
         te::AudioFile audioFile (engine, loadedFile);
         thumbnail = std::make_unique<te::SmartThumbnail> (engine, audioFile, thumbnailComponent, nullptr);
     }
+
+    thumbnailFile = loadedFile;
 }
 
 AudioEngine::TimePosition AudioEngine::clampToTimeline (TimePosition pos) const
@@ -2,7 +2,22 @@
 
 #include <JuceHeader.h>
 #include <tracktion_engine/tracktion_engine.h>
+#include "AudioFingerprintIndex.h"
+#include "LoopPreview.h"
+#include "PerformanceMonitor.h"
+#include "PlaylistPrefetcher.h"
+#include "PluginScanner.h"
+#include "RenderCache.h"
+#include "SelectionSet.h"
+#include "SharedClipboard.h"
+#include "SourceProxyCache.h"
+#include "ScrubEngine.h"
+#include "TakeRecorder.h"
+#include "TimeStretchRenderer.h"
+#include <functional>
+#include <map>
 #include <optional>
+#include <set>
 #include <vector>
 
 namespace te = tracktion;
@@ -19,14 +34,38 @@ public:
     virtual bool createNewEdit (const juce::String& tempName) = 0;
     virtual bool loadFile (const juce::File& file, juce::String& statusOut) = 0;
 
+    /** Opens and validates file on a background thread, then loads it on the message thread,
+        so a large file or a slow network disk doesn't freeze the UI. Playback can start as
+        soon as onComplete has been called; the thumbnail fills in progressively after that.
+        Starting another load or calling cancelLoad() abandons a pending one, whose onComplete
+        is then never called.
+    */
+    virtual void loadFileAsync (const juce::File& file, std::function<void (bool loaded, const juce::String& status)> onComplete) = 0;
+    virtual void cancelLoad() = 0;
+    virtual bool isLoading() const = 0;
+
+    /** Review playlists: loadPlaylistItem() loads one file asynchronously and prefetches the
+        next few in the background (reading their headers and starts into the OS cache, scanning
+        waveforms and decoding proxies),
+        so stepping through hundreds of files doesn't pay the whole load cost for each.
+    */
+    virtual void setPlaylist (const juce::Array<juce::File>& files) = 0;
+    virtual const juce::Array<juce::File>& getPlaylist() const = 0;
+    virtual int getPlaylistIndex() const = 0;
+    virtual bool loadPlaylistItem (int index, std::function<void (bool loaded, const juce::String& status)> onComplete) = 0;
+
     using TimeRange = te::TimeRange;
     using TimePosition = te::TimePosition;
     using TimeDuration = te::TimeDuration;
 
+    /** A stretch of the timeline taken from source, starting sourceOffset into it. Segments
+        normally come from the loaded file, but recorded takes bring in other sources.
+    */
     struct Segment
     {
         TimeDuration length {};
         TimeDuration sourceOffset {};
+        juce::File source;
     };
 
     struct ClipboardFragment
@@ -34,32 +73,173 @@ public:
         TimeDuration relativeStart {};
         TimeDuration length {};
         TimeDuration sourceOffset {};
+        juce::File source;
     };
 
     virtual const std::vector<Segment>& getSegments() const = 0;
+
+    /** The same timeline as getSegments(), but with consolidated runs (see consolidateFragments())
+        mapped back to the pieces of source they were rendered from. Analysis of the loaded file,
+        like the spectrogram and similarity search, goes by these. Updated when the track is rebuilt.
+    */
+    virtual const std::vector<Segment>& getSourceSegments() const = 0;
     virtual TimeDuration getTotalLength() const = 0;
     virtual te::SmartThumbnail* getThumbnail() const = 0;
     virtual juce::File getDisplayFile() const = 0;
+    virtual juce::File getSourceFile() const = 0;
 
     virtual void setInsertionPoint (TimePosition pos) = 0;
     virtual TimePosition getInsertionPoint() const = 0;
 
     virtual bool copySelection (TimeRange selection) = 0;
     virtual bool cutSelection (TimeRange selection) = 0;
+    /** Pasting audio copied in another instance may need a copy of it made first (another rate,
+        or audio that instance will delete); that happens in the background, and the paste is
+        then made as its own undo step.
+    */
     virtual bool pasteClipboard (TimePosition insertAt) = 0;
     virtual bool hasClipboard() const = 0;
 
+    /** Batched edits over several ranges. Each walks the segment list once and rebuilds once,
+        so a whole batch is a single undo step for the caller. Cut copies to the clipboard
+        (ranges joined end to end) and then deletes; delete leaves the clipboard alone.
+    */
+    virtual bool copySelections (const SelectionSet& selection) = 0;
+    virtual bool cutSelections (const SelectionSet& selection) = 0;
+    virtual bool deleteSelections (const SelectionSet& selection) = 0;
+    virtual bool normaliseSelections (const SelectionSet& selection, juce::String& statusOut) = 0;
+
     virtual void pushUndoState (const std::optional<TimeRange>& selection, TimePosition insertion) = 0;
     virtual bool undo (std::optional<TimeRange>& selectionOut, TimePosition& insertionOut) = 0;
 
+    /** Edits made between beginBatch() and endBatch() form one step: the track is rebuilt
+        once, at the end, and a single undo state (pushed by beginBatch) covers all of them.
+        endBatch (false) rolls the whole batch back instead. Batches may nest.
+    */
+    virtual void beginBatch (const std::optional<TimeRange>& selection) = 0;
+    virtual void endBatch (bool commit) = 0;
+
     virtual bool normaliseRange (TimeRange range, juce::String& statusOut) = 0;
+
+    /** Replaces the selection with a time-stretched (lengthRatio = new length / old length)
+        and pitch-shifted render of it. Rendering happens on worker threads and results are
+        cached by content, so repeating a stretch is immediate. onComplete is called on the
+        message thread once the selection has been replaced (after an undo state is pushed).
+    */
+    virtual bool stretchSelection (TimeRange selection, double lengthRatio, float semitones,
+                                   std::function<void (bool succeeded, const juce::String& status)> onComplete) = 0;
+    virtual bool isStretching() const = 0;
+
+    /** Segments that continue each other in the same source are merged after every edit.
+        This goes further: runs of many short segments (left by lots of small edits) are
+        rendered in the background into one contiguous file each and swapped in as a single
+        undo step, so playback and export read them sequentially. getSourceSegments() still
+        reports the original pieces. Returns false if there is nothing worth consolidating.
+    */
+    virtual bool consolidateFragments (std::function<void (bool succeeded, const juce::String& status)> onComplete) = 0;
+    virtual bool isConsolidating() const = 0;
+
+    /** Extra tracks (stems, other mics) play and export mixed with the main track. Linked tracks
+        follow every cut and paste made on the main timeline, so they stay in sync with it.
+    */
+    virtual bool addTrack (const juce::File& file, bool linked, juce::String& statusOut) = 0;
+    virtual int getNumExtraTracks() const = 0;
+    virtual const std::vector<Segment>& getExtraTrackSegments (int index) const = 0;
+    virtual juce::File getExtraTrackSource (int index) const = 0;
+    virtual bool isExtraTrackLinked (int index) const = 0;
+    virtual void setExtraTrackLinked (int index, bool linked) = 0;
+
+    /** Markers split the timeline into regions (chapters, songs): each region runs from a marker
+        to the next one, or to the end. They move with the audio around them when it is cut or
+        pasted, and are part of the undo state.
+    */
+    struct Marker
+    {
+        juce::String name;
+        TimePosition position {};
+    };
+
+    struct Region
+    {
+        juce::String name;
+        TimeRange range {};
+    };
+
+    virtual int addMarker (TimePosition position, const juce::String& name) = 0;
+    virtual void removeMarker (int index) = 0;
+    virtual void renameMarker (int index, const juce::String& name) = 0;
+    virtual const std::vector<Marker>& getMarkers() const = 0;
+    virtual std::vector<Region> getRegions() const = 0;
+
+    struct SimilarRegion
+    {
+        double startMs = 0.0;
+        double endMs = 0.0;
+        int score = 0;
+
+        TimeRange toTimeRange() const    { return { TimePosition::fromSeconds (startMs / 1000.0), TimePosition::fromSeconds (endMs / 1000.0) }; }
+    };
+
+    /** Finds timeline ranges that sound like the selection (e.g. the same sentence recorded twice).
+        Results are best match first; empty until the background fingerprint index has been built.
+    */
+    virtual std::vector<SimilarRegion> findSimilarRegions (TimeRange selection) const = 0;
+
+    /** Scrubbing plays the edited timeline directly on the audio thread, independent of the transport.
+        Speed is relative to normal playback; negative speeds play backwards.
+    */
+    virtual bool startScrub (TimePosition from, double speed) = 0;
+    virtual void setScrubSpeed (double speed) = 0;
+    virtual TimePosition stopScrub() = 0;
+    virtual bool isScrubbing() const = 0;
+    virtual TimePosition getScrubPosition() const = 0;
+
+    /** Records from the audio inputs. Playback runs from preRollSeconds before the insertion
+        point; when recording stops the take is inserted there like a paste (pushing an undo
+        state first) and the insertion point moves to its end. The take is lined up with the
+        timeline as it actually played, allowing for the device's input and output latency.
+        stopRecording() finishes the take (converting its rate if needed) in the background and
+        calls onComplete on the message thread once it has been inserted or has failed.
+    */
+    virtual bool startRecording (double preRollSeconds, juce::String& statusOut) = 0;
+    virtual bool stopRecording (juce::String& statusOut, std::function<void (bool, const juce::String&)> onComplete = {}) = 0;
+    virtual bool isRecording() const = 0;
+    virtual TakeRecorder::Stats getRecordingStats() const = 0;
+
+    /** Loops range from a render of it through the track and master effects, so auditioning
+        heavy plugin chains costs next to nothing. Renders are cached and only redone when the
+        range or the effect state changes; the transport is stopped while previewing.
+    */
+    virtual bool startLoopPreview (TimeRange range) = 0;
+    virtual void stopLoopPreview() = 0;
+    virtual bool isLoopPreviewing() const = 0;
+
+    /** Audio-thread load, dropouts and graph rebuilds, refreshed once a second on the message thread. */
+    virtual const PerformanceMonitor::Snapshot& getPerformanceSnapshot() const = 0;
+
+    /** Rescans plugin folders in the background, only loading binaries that changed since the last scan. */
+    virtual void startPluginScan() = 0;
+    virtual bool isScanningPlugins() const = 0;
 };
 
 class AudioEngine : public IAudioEngine
 {
 public:
-    AudioEngine();
-    ~AudioEngine() override = default;
+    /** An engine created with openAudioDevice false never opens a device, for headless use. */
+    explicit AudioEngine (bool openAudioDevice = true);
+    ~AudioEngine() override;
+
+    /** Opens the audio device. This is deferred until after the main window has painted
+        (or until something needs it) so startup isn't blocked on device enumeration.
+        Returns false without opening anything on a headless engine.
+    */
+    bool initialiseAudioDevice();
+    void enableAllInputChannels();
+
+    RenderCache& getRenderCache()       { return renderCache; }
+
+    /** Writes a line to the audio performance log, which release builds keep too. */
+    void logPerformanceEvent (const juce::String& message)      { performanceMonitor.logEvent (message); }
 
     te::Engine& getEngine() override;
     te::Edit* getEdit() override;
@@ -67,11 +247,21 @@ public:
 
     bool createNewEdit (const juce::String& tempName) override;
     bool loadFile (const juce::File& file, juce::String& statusOut) override;
+    void loadFileAsync (const juce::File& file, std::function<void (bool, const juce::String&)> onComplete) override;
+    void cancelLoad() override;
+    bool isLoading() const override;
+
+    void setPlaylist (const juce::Array<juce::File>& files) override;
+    const juce::Array<juce::File>& getPlaylist() const override;
+    int getPlaylistIndex() const override;
+    bool loadPlaylistItem (int index, std::function<void (bool, const juce::String&)> onComplete) override;
 
     const std::vector<Segment>& getSegments() const override;
+    const std::vector<Segment>& getSourceSegments() const override;
     TimeDuration getTotalLength() const override;
     te::SmartThumbnail* getThumbnail() const override;
     juce::File getDisplayFile() const override;
+    juce::File getSourceFile() const override;
 
     void setInsertionPoint (TimePosition pos) override;
     TimePosition getInsertionPoint() const override;
@@ -81,34 +271,180 @@ public:
     bool pasteClipboard (TimePosition insertAt) override;
     bool hasClipboard() const override;
 
+    bool copySelections (const SelectionSet& selection) override;
+    bool cutSelections (const SelectionSet& selection) override;
+    bool deleteSelections (const SelectionSet& selection) override;
+    bool normaliseSelections (const SelectionSet& selection, juce::String& statusOut) override;
+
     void pushUndoState (const std::optional<TimeRange>& selection, TimePosition insertion) override;
     bool undo (std::optional<TimeRange>& selectionOut, TimePosition& insertionOut) override;
 
+    void beginBatch (const std::optional<TimeRange>& selection) override;
+    void endBatch (bool commit) override;
+
     bool normaliseRange (TimeRange range, juce::String& statusOut) override;
 
+    bool stretchSelection (TimeRange selection, double lengthRatio, float semitones,
+                           std::function<void (bool, const juce::String&)> onComplete) override;
+    bool isStretching() const override;
+
+    bool consolidateFragments (std::function<void (bool, const juce::String&)> onComplete) override;
+    bool isConsolidating() const override;
+
+    bool addTrack (const juce::File& file, bool linked, juce::String& statusOut) override;
+    int getNumExtraTracks() const override;
+    const std::vector<Segment>& getExtraTrackSegments (int index) const override;
+    juce::File getExtraTrackSource (int index) const override;
+    bool isExtraTrackLinked (int index) const override;
+    void setExtraTrackLinked (int index, bool linked) override;
+
+    int addMarker (TimePosition position, const juce::String& name) override;
+    void removeMarker (int index) override;
+    void renameMarker (int index, const juce::String& name) override;
+    const std::vector<Marker>& getMarkers() const override;
+    std::vector<Region> getRegions() const override;
+
+    std::vector<SimilarRegion> findSimilarRegions (TimeRange selection) const override;
+
+    bool startScrub (TimePosition from, double speed) override;
+    void setScrubSpeed (double speed) override;
+    TimePosition stopScrub() override;
+    bool isScrubbing() const override;
+    TimePosition getScrubPosition() const override;
+
+    bool startRecording (double preRollSeconds, juce::String& statusOut) override;
+    bool stopRecording (juce::String& statusOut, std::function<void (bool, const juce::String&)> onComplete = {}) override;
+    bool isRecording() const override;
+    TakeRecorder::Stats getRecordingStats() const override;
+
+    bool startLoopPreview (TimeRange range) override;
+    void stopLoopPreview() override;
+    bool isLoopPreviewing() const override;
+
+    const PerformanceMonitor::Snapshot& getPerformanceSnapshot() const override;
+
+    void startPluginScan() override;
+    bool isScanningPlugins() const override;
+
 private:
+    void installLoadedFile (const juce::File& file, TimeDuration length);
     void rebuildTrack();
+    juce::File rebuildClip (te::AudioTrack& target, const juce::File& source, const std::vector<Segment>& trackSegments);
+    juce::File writeEditListFile (const juce::File& source, const std::vector<Segment>& trackSegments);
+    bool createExtraTrack (const juce::File& file, bool linked);
+    void removeExtraTrack (size_t index);
+    void removeExtraTracks();
+    void cutTrack (std::vector<Segment>& trackSegments, const SelectionSet& selection);
+    void insertIntoTrack (std::vector<Segment>& trackSegments, TimePosition insertion, const std::vector<ClipboardFragment>& fragments);
+    void insertIntoTrack (std::vector<Segment>& trackSegments, TimePosition insertion, const ClipboardFragment& fragment);
+    void spliceRender (TimeRange selection, const juce::File& render);
+    void requestProxy (const juce::File& source);
+    void updatePlaylistPrefetch();
+    void publishClipboard();
+    bool takeSharedClipboard (TimePosition pasteAt);
+    void installSharedClipboard (std::vector<ClipboardFragment>);
+    juce::File convertPastedFragment (const SharedClipboard::Fragment&, double targetRate);
     void updateDisplayThumbnailFromTrack();
     TimePosition clampToTimeline (TimePosition pos) const;
     void logTrackClipDebugInfo() const;
 
     te::Engine engine;
+    PerformanceMonitor performanceMonitor { engine.getDeviceManager().deviceManager,
+                                            engine.getPropertyStorage().getAppPrefsFolder().getChildFile ("Logs/AudioPerformance.log") };
+    RenderCache renderCache { engine.getPropertyStorage().getAppCacheFolder().getChildFile ("RenderCache"),
+                              (juce::int64) 2 * 1024 * 1024 * 1024 };
+    SourceProxyCache proxyCache { engine.getPropertyStorage().getAppCacheFolder().getChildFile ("Proxies"),
+                                  (juce::int64) 8 * 1024 * 1024 * 1024, engine.getAudioFileFormatManager().readFormatManager };
+    juce::TimeSliceThread backgroundThread { "Editor background" };
+    ScrubEngine scrubEngine { backgroundThread };
+    TakeRecorder takeRecorder { backgroundThread };
+    LoopPreview loopPreview { renderCache, engine.getAudioFileFormatManager().readFormatManager };
+    std::optional<TimeRange> transportLoopRange;    // set while a loop too long for loopPreview plays through the transport
+    AudioFingerprintIndex fingerprintIndex { engine.getAudioFileFormatManager().readFormatManager };
+    TimeStretchRenderer stretchRenderer { engine.getAudioFileFormatManager().readFormatManager };
+    std::unique_ptr<PluginScanner> pluginScanner;
+    juce::ThreadPool loadPool { 1 };
+    PlaylistPrefetcher playlistPrefetcher { engine.getAudioFileFormatManager().readFormatManager, (juce::int64) 512 * 1024 * 1024 };
+    static constexpr int playlistPrefetchDepth = 3;
+    juce::Array<juce::File> playlist;
+    int playlistIndex = -1;
+    int loadGeneration = 0;
+    bool loadPending = false;
+    bool consolidatePending = false;
+
+    // Each instance keeps its edit lists in a folder of its own, since another instance could
+    // otherwise delete a content-addressed file this one still plays. Declared before the edit
+    // so it's only removed once the edit's readers are gone.
+    struct OwnedDirectory
+    {
+        juce::File directory;
+        ~OwnedDirectory()       { directory.deleteRecursively(); }
+    };
+
+    const OwnedDirectory editListDirectory { engine.getTemporaryFileManager().getTempDirectory()
+                                               .getChildFile ("EditLists").getChildFile (juce::Uuid().toString()) };
     std::unique_ptr<te::Edit> edit;
     te::AudioTrack* track = nullptr;
     juce::File loadedFile;
     juce::File displayFile;
+    juce::File editListFile;
+    juce::File currentTakeFile;
+    int timelineVersion = 0;
+    TimePosition recordInsertion {};
+    TimePosition recordPlayStart {};                // where playback was started for the take
     TimeDuration loadedFileLength {};
     juce::Component thumbnailComponent;
     std::unique_ptr<te::SmartThumbnail> thumbnail;
+    juce::File thumbnailFile;
+    std::vector<std::pair<juce::File, std::unique_ptr<te::SmartThumbnail>>> prefetchedThumbnails;
     TimePosition insertionPoint {};
 
     std::vector<Segment> segments;
+    std::vector<Segment> sourceSegments;                        // only kept up to date while consolidatedOrigins isn't empty
+    std::map<juce::File, std::vector<Segment>> consolidatedOrigins; // what each consolidated file was rendered from
+
+    // Audio written for the timeline (takes, stretches, consolidated runs) is owned by the
+    // instance that inserted it and deleted once nothing it holds refers to it any more.
+    void adoptGeneratedFile (const juce::File&);
+    bool isGeneratedAudio (const juce::File&) const;
+    void deleteUnreferencedFiles();
+    std::set<juce::File> generatedFiles;
     std::vector<ClipboardFragment> clipboard;
+    SharedClipboard sharedClipboard { "NonDestructiveEditor" };
+    bool sharedPastePending = false;                // a shared paste is being copied in the background
+    std::vector<Marker> markers;
+
+    // Reused by every edit so that, once they've grown, editing the segment lists doesn't allocate.
+    std::vector<Segment> scratchSegments;
+    std::vector<ClipboardFragment> scratchFragments;
+    std::vector<SharedClipboard::Fragment> sharedFragments;
+    SelectionSet scratchSelection;
+
+    struct ExtraTrack
+    {
+        te::AudioTrack* track = nullptr;
+        juce::File source, editListFile;
+        std::vector<Segment> segments;
+        std::vector<ClipboardFragment> clipboard;
+        bool linked = true;
+    };
+
+    std::vector<ExtraTrack> extraTracks;
+
+    struct ExtraTrackState
+    {
+        std::vector<Segment> segments;
+        std::vector<ClipboardFragment> clipboard;
+        juce::File source;
+        bool linked = true;
+    };
 
     struct UndoState
     {
         std::vector<Segment> segments;
         std::vector<ClipboardFragment> clipboard;
+        std::vector<ExtraTrackState> extraTracks;
+        std::vector<Marker> markers;
         std::optional<TimeRange> selection;
         TimePosition insertionPoint {};
         juce::File loadedFile;
@@ -116,6 +452,13 @@ private:
     };
 
     std::vector<UndoState> undoStack;
+    UndoState spareUndoState;
     const size_t maxUndoHistory = 25;
     bool applyingUndo = false;
+    int batchDepth = 0;
+    bool rebuildPending = false;
+    const bool audioDeviceAllowed;
+    bool audioDeviceInitialised = false;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (AudioEngine)
 };
@@ -1,4 +1,6 @@
 #include "AudioExporter.h"
+#include "SampleRateConverter.h"
+#include "Wave64AudioFormat.h"
 
 namespace
 {
@@ -9,6 +11,8 @@ namespace
             return std::make_unique<juce::AiffAudioFormat>();
         if (lower.contains ("flac"))
             return std::make_unique<juce::FlacAudioFormat>();
+        if (lower.contains ("w64"))
+            return std::make_unique<Wave64AudioFormat>();
         if (lower.contains ("ogg"))
             return std::make_unique<juce::OggVorbisAudioFormat>();
         if (lower.contains ("mp3"))
@@ -30,9 +34,282 @@ namespace
            #endif
         }
 
+        // Switches to RF64 by itself once the data passes 4 GB.
         return std::make_unique<juce::WavAudioFormat>();
     }
 
+    // Scripted exports name only the destination, so its extension picks the format; one that
+    // isn't recognised is refused rather than written as WAV under the wrong name.
+    std::unique_ptr<juce::AudioFormat> createFormatForFile (const juce::File& dest)
+    {
+        if (dest.hasFileExtension ("wav;wave;bwf"))
+            return std::make_unique<juce::WavAudioFormat>();
+        if (dest.hasFileExtension ("aif;aiff"))
+            return std::make_unique<juce::AiffAudioFormat>();
+        if (dest.hasFileExtension ("flac;w64;ogg;mp3;m4a"))
+            return createFormatFromName (dest.getFileExtension().trimCharactersAtStart ("."));
+
+        return nullptr;
+    }
+
+    juce::String describeRender (te::Edit& edit, const te::Renderer::Parameters& params, const juce::String& formatName)
+    {
+        juce::String description;
+        description << "export|" << formatName
+                    << "|" << params.time.getStart().inSeconds() << "|" << params.time.getEnd().inSeconds()
+                    << "|" << params.sampleRateForAudio << "|" << params.blockSizeForAudio
+                    << "|" << params.bitDepth << "|" << params.quality
+                    << "|" << (params.ditheringEnabled ? 1 : 0) << "\n";
+
+        for (auto* track : te::getAudioTracks (edit))
+            description << RenderCache::describeState (track->state);
+
+        description << RenderCache::describeState (edit.state.getChildWithName (te::IDs::MASTERPLUGINS));
+        return description;
+    }
+
+    // resampleFromRate is the rate the edit is rendered at before conversion, or 0 when it
+    // renders at the export rate directly.
+    juce::String createRenderKey (te::Edit& edit, const te::Renderer::Parameters& params, const juce::String& formatName,
+                                  double resampleFromRate, SampleRateConverter::Quality resamplerQuality)
+    {
+        auto description = describeRender (edit, params, formatName);
+
+        if (resampleFromRate > 0.0)
+            description << "src|" << resampleFromRate << "|" << SampleRateConverter::getQualityNames()[(int) resamplerQuality] << "\n";
+
+        return RenderCache::createKey (description);
+    }
+
+    class ResampleJob : public te::ThreadPoolJobWithProgress
+    {
+    public:
+        ResampleJob (const juce::File& sourceToUse, const juce::File& destToUse, juce::AudioFormat& formatToUse,
+                     const te::Renderer::Parameters& params, SampleRateConverter::Quality qualityToUse, double rate)
+            : te::ThreadPoolJobWithProgress ("Resampling"),
+              source (sourceToUse), dest (destToUse), format (formatToUse),
+              outputRate (rate), bitDepth (params.bitDepth), qualityOptionIndex (params.quality),
+              dither (params.ditheringEnabled), quality (qualityToUse)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            succeeded = SampleRateConverter::convertFile (source, dest, format, outputRate, bitDepth,
+                                                          qualityOptionIndex, dither, quality, progress);
+            return jobHasFinished;
+        }
+
+        float getCurrentTaskProgress() override     { return progress.load(); }
+
+        bool succeeded = false;
+
+    private:
+        const juce::File source, dest;
+        juce::AudioFormat& format;
+        const double outputRate;
+        const int bitDepth, qualityOptionIndex;
+        const bool dither;
+        const SampleRateConverter::Quality quality;
+        std::atomic<float> progress { 0.0f };
+    };
+
+    // Runs fn on the message thread and waits for it. Only used from jobs started through
+    // runTaskWithProgressBar, which keeps the message loop running meanwhile.
+    template <typename Fn>
+    void callOnMessageThreadAndWait (Fn&& fn)
+    {
+        juce::WaitableEvent done;
+        juce::MessageManager::callAsync ([&] { fn(); done.signal(); });
+        done.wait();
+    }
+
+    // Regions are numbered in timeline order, so exporting the same markers again gives the same names.
+    juce::File getRegionFile (const juce::File& folder, const juce::String& baseName, int index, int numRegions,
+                              const juce::String& regionName, const juce::String& extension)
+    {
+        auto name = juce::String (index + 1).paddedLeft ('0', juce::jmax (2, juce::String (numRegions).length()));
+
+        if (baseName.isNotEmpty())
+            name = baseName + " - " + name;
+
+        if (regionName.isNotEmpty())
+            name << " - " << regionName;
+
+        return folder.getChildFile (juce::File::createLegalFileName (name) + "." + extension);
+    }
+
+    /** Renders each region to its own file. Every render gets its own copy of the edit, so
+        plugin instances are never shared between threads, and at most jobLimit run at once.
+    */
+    class SplitExportJob : public te::ThreadPoolJobWithProgress
+    {
+    public:
+        struct Item
+        {
+            te::TimeRange range;
+            juce::File destFile;
+        };
+
+        SplitExportJob (te::Edit& editToCopy, const te::Renderer::Parameters& templateParams, const juce::String& formatName,
+                        std::vector<Item> itemsToRender, int maxJobs, double nativeRateToUse,
+                        SampleRateConverter::Quality resamplerQualityToUse, RenderCache* cacheToUse)
+            : te::ThreadPoolJobWithProgress ("Exporting regions"),
+              edit (editToCopy), params (templateParams), items (std::move (itemsToRender)),
+              jobLimit (juce::jmax (1, maxJobs)), nativeRate (nativeRateToUse),
+              resamplerQuality (resamplerQualityToUse), cache (cacheToUse),
+              progress (items.size())
+        {
+            // Keys read the edit state, so they're worked out here on the message thread.
+            for (auto& item : items)
+            {
+                auto itemParams = params;
+                itemParams.time = item.range;
+                keys.push_back (cache != nullptr ? createRenderKey (edit, itemParams, formatName, getResampleFromRate(), resamplerQuality)
+                                                 : juce::String());
+            }
+        }
+
+        JobStatus runJob() override
+        {
+            juce::ThreadPool pool (jobLimit);
+
+            for (size_t i = 0; i < items.size(); ++i)
+                pool.addJob ([this, i] { renderItem (i); });
+
+            while (pool.getNumJobs() > 0)
+                juce::Thread::sleep (50);
+
+            return jobHasFinished;
+        }
+
+        float getCurrentTaskProgress() override
+        {
+            float total = 0.0f;
+            for (auto& p : progress)
+                total += p.load();
+
+            return items.empty() ? 1.0f : total / (float) items.size();
+        }
+
+        int getNumSucceeded() const     { return numSucceeded.load(); }
+        int getNumFromCache() const     { return numFromCache.load(); }
+
+    private:
+        double getResampleFromRate() const
+        {
+            return std::abs (params.sampleRateForAudio - nativeRate) > 0.5 ? nativeRate : 0.0;
+        }
+
+        void renderItem (size_t index)
+        {
+            auto& item = items[index];
+            item.destFile.deleteFile();
+
+            if (cache != nullptr)
+            {
+                auto cached = cache->find (keys[index], item.destFile.getFileExtension());
+
+                if (cached.existsAsFile() && cached.copyFileTo (item.destFile))
+                {
+                    progress[index] = 1.0f;
+                    ++numSucceeded;
+                    ++numFromCache;
+                    return;
+                }
+            }
+
+            const bool resample = getResampleFromRate() > 0.0;
+            juce::TemporaryFile intermediate (".wav");
+            juce::WavAudioFormat floatWav;
+
+            auto itemParams = params;
+            itemParams.time = item.range;
+            itemParams.destFile = item.destFile;
+
+            if (resample)
+            {
+                // As for a single export: render a float WAV at the native rate, then resample and encode.
+                itemParams.destFile = intermediate.getFile();
+                itemParams.audioFormat = &floatWav;
+                itemParams.sampleRateForAudio = nativeRate;
+                itemParams.bitDepth = 32;
+                itemParams.quality = 0;
+                itemParams.ditheringEnabled = false;
+            }
+
+            std::unique_ptr<te::Edit> editCopy;
+            std::unique_ptr<te::Renderer::RenderTask> task;
+            std::atomic<float> renderProgress { 0.0f }, resampleProgress { 0.0f };
+
+            callOnMessageThreadAndWait ([&]
+            {
+                te::Edit::Options options { edit.engine, edit.state.createCopy(), te::ProjectItemID::createNewID (0) };
+                options.role = te::Edit::forRendering;
+                options.numUndoLevelsToStore = 0;
+                editCopy = te::Edit::createEdit (options);
+
+                itemParams.edit = editCopy.get();
+                itemParams.tracksToDo = te::toBitSet (te::getAllTracks (*editCopy));
+                task = std::make_unique<te::Renderer::RenderTask> (getJobName(), itemParams, &renderProgress, nullptr);
+            });
+
+            auto updateProgress = [&]
+            {
+                progress[index] = resample ? 0.5f * (renderProgress.load() + resampleProgress.load())
+                                           : renderProgress.load();
+            };
+
+            while (! shouldExit())
+            {
+                const auto status = task->runJob();
+                updateProgress();
+
+                if (status != juce::ThreadPoolJob::jobNeedsRunningAgain)
+                    break;
+            }
+
+            callOnMessageThreadAndWait ([&]
+            {
+                task.reset();
+                editCopy.reset();
+            });
+
+            bool succeeded = itemParams.destFile.getSize() > 0 && ! shouldExit();
+
+            if (succeeded && resample)
+                succeeded = SampleRateConverter::convertFile (intermediate.getFile(), item.destFile, *params.audioFormat,
+                                                              params.sampleRateForAudio, params.bitDepth, params.quality,
+                                                              params.ditheringEnabled, resamplerQuality, resampleProgress);
+
+            if (succeeded)
+            {
+                if (cache != nullptr)
+                    cache->store (keys[index], item.destFile);
+
+                ++numSucceeded;
+            }
+            else
+            {
+                item.destFile.deleteFile();
+                DBG ("Split export: couldn't render " << item.destFile.getFileName());
+            }
+
+            progress[index] = 1.0f;
+        }
+
+        te::Edit& edit;
+        const te::Renderer::Parameters params;
+        std::vector<Item> items;
+        std::vector<juce::String> keys;
+        const int jobLimit;
+        const double nativeRate;
+        const SampleRateConverter::Quality resamplerQuality;
+        RenderCache* cache = nullptr;
+        std::vector<std::atomic<float>> progress;
+        std::atomic<int> numSucceeded { 0 }, numFromCache { 0 };
+    };
+
     juce::String describeRange (te::TimeRange range)
     {
         return juce::String (range.getStart().inSeconds(), 2) + "s to "
@@ -41,6 +318,11 @@ namespace
     }
 }
 
+AudioExporter::AudioExporter (RenderCache* cacheToUse)
+    : renderCache (cacheToUse)
+{
+}
+
 void AudioExporter::showExportDialog (const ExportContext& context)
 {
     if (context.edit == nullptr || context.engine == nullptr)
@@ -48,7 +330,8 @@ void AudioExporter::showExportDialog (const ExportContext& context)
 
     juce::AlertWindow dialog ("Export Options", "Choose export settings", juce::MessageBoxIconType::NoIcon);
     const juce::String formatId = "format", rateId = "rate", depthId = "depth",
-                        qualId = "quality", nameId = "name", bitrateId = "bitrate";
+                        qualId = "quality", nameId = "name", bitrateId = "bitrate", resamplerId = "resampler",
+                        jobsId = "jobs";
 
     dialog.addTextEditor (nameId, context.defaultName.isNotEmpty() ? context.defaultName : juce::String ("Export"), "Filename");
 
@@ -64,12 +347,17 @@ void AudioExporter::showExportDialog (const ExportContext& context)
     dialog.addCustomComponent (wholeFileButton.get());
     dialog.addCustomComponent (selectionButton.get());
 
+    auto splitButton = std::make_unique<juce::ToggleButton> ("Split at markers (" + juce::String ((int) context.regions.size()) + " files)");
+    splitButton->setSize (340, 24);
+    splitButton->setEnabled (! context.regions.empty());
+    dialog.addCustomComponent (splitButton.get());
+
     auto rangeLabel = std::make_unique<juce::Label> ("rangeLabel", juce::String());
     rangeLabel->setJustificationType (juce::Justification::centredLeft);
     rangeLabel->setSize (340, 24);
     dialog.addCustomComponent (rangeLabel.get());
 
-    dialog.addComboBox (formatId, { "WAV", "AIFF", "FLAC", "OGG", "MP3", "M4A" }, "Format");
+    dialog.addComboBox (formatId, { "WAV", "W64", "AIFF", "FLAC", "OGG", "MP3", "M4A" }, "Format");
     auto* formatBox = dialog.getComboBoxComponent (formatId);
     formatBox->setSelectedId (1); // WAV
 
@@ -77,6 +365,19 @@ void AudioExporter::showExportDialog (const ExportContext& context)
     auto* rateBox = dialog.getComboBoxComponent (rateId);
     rateBox->setSelectedId (1);
 
+    dialog.addComboBox (resamplerId, SampleRateConverter::getQualityNames(), "Resampler quality");
+    auto* resamplerBox = dialog.getComboBoxComponent (resamplerId);
+    resamplerBox->setSelectedId (3);
+
+    // Each parallel render holds its own copy of the edit and its plugins, hence the limit.
+    juce::StringArray jobLimits;
+    for (int n = 1; n <= juce::jmax (1, juce::SystemStats::getNumCpus()); n *= 2)
+        jobLimits.add (juce::String (n));
+
+    dialog.addComboBox (jobsId, jobLimits, "Parallel renders");
+    auto* jobsBox = dialog.getComboBoxComponent (jobsId);
+    jobsBox->setSelectedItemIndex (juce::jmin (2, jobLimits.size() - 1));
+
     dialog.addComboBox (depthId, { "16", "24", "32 (float)" }, "Bit depth");
     auto* depthBox = dialog.getComboBoxComponent (depthId);
     depthBox->setSelectedId (1);
@@ -107,11 +408,19 @@ void AudioExporter::showExportDialog (const ExportContext& context)
 
     auto* rangeLabelPtr = rangeLabel.get();
     auto* selectionButtonPtr = selectionButton.get();
-    auto updateExportRangeLabel = [rangeLabelPtr, selectionButtonPtr, &context]
+    auto* splitButtonPtr = splitButton.get();
+    auto updateExportRangeLabel = [rangeLabelPtr, selectionButtonPtr, splitButtonPtr, &context]
     {
         if (rangeLabelPtr == nullptr)
             return;
 
+        if (splitButtonPtr->getToggleState())
+        {
+            rangeLabelPtr->setText ("Will export " + juce::String ((int) context.regions.size()) + " regions to a folder",
+                                    juce::dontSendNotification);
+            return;
+        }
+
         const bool useSelection = context.hasSelection && selectionButtonPtr != nullptr && selectionButtonPtr->getToggleState();
         const auto range = useSelection ? context.selectionRange : context.fullRange;
         rangeLabelPtr->setText ("Will export: " + describeRange (range), juce::dontSendNotification);
@@ -119,6 +428,7 @@ void AudioExporter::showExportDialog (const ExportContext& context)
 
     wholeFileButton->onClick = updateExportRangeLabel;
     selectionButton->onClick = updateExportRangeLabel;
+    splitButton->onClick = updateExportRangeLabel;
     updateExportRangeLabel();
 
     formatBox->onChange = updateVisibility;
@@ -135,6 +445,7 @@ void AudioExporter::showExportDialog (const ExportContext& context)
     auto depthStr = depthBox != nullptr ? depthBox->getText() : juce::String ("16");
     auto qualIndex = qualityBox != nullptr ? qualityBox->getSelectedItemIndex() : 2;
     auto bitrateStr = bitrateBox != nullptr ? bitrateBox->getText() : juce::String ("256");
+    auto resamplerQuality = SampleRateConverter::getQualityForName (resamplerBox != nullptr ? resamplerBox->getText() : juce::String ("High"));
 
     auto oggQuality = juce::jlimit (0, 10, qualIndex == 0 ? 0 : (qualIndex == 1 ? 4 : (qualIndex == 2 ? 6 : 10)));
     auto bitrate = juce::jlimit (64, 512, bitrateStr.getIntValue());
@@ -143,33 +454,51 @@ void AudioExporter::showExportDialog (const ExportContext& context)
     int chosenDepth = depthStr.contains ("32") ? 32 : depthStr.getIntValue();
     const bool exportSelection = context.hasSelection && selectionButton != nullptr && selectionButton->getToggleState();
     auto exportRange = exportSelection ? context.selectionRange : context.fullRange;
+    const bool splitExport = splitButton->getToggleState() && ! context.regions.empty();
+    const auto jobLimit = jobsBox != nullptr ? jobsBox->getText().getIntValue() : 1;
+    const auto baseName = dialog.getTextEditorContents (nameId).trim();
 
     auto fmtLower = fmtName.toLowerCase();
     juce::String extension = "wav";
     if (fmtLower.contains ("aiff")) extension = "aiff";
+    else if (fmtLower.contains ("w64")) extension = "w64";
     else if (fmtLower.contains ("flac")) extension = "flac";
     else if (fmtLower.contains ("ogg")) extension = "ogg";
     else if (fmtLower.contains ("mp3")) extension = "mp3";
     else if (fmtLower.contains ("m4a")) extension = "m4a";
 
     auto pattern = "*." + extension;
-    auto chooser = std::make_shared<juce::FileChooser> ("Choose export destination",
-                                                        context.engine->getPropertyStorage().getDefaultLoadSaveDirectory ("editExport")
-                                                            .getChildFile (dialog.getTextEditorContents (nameId))
-                                                            .withFileExtension (extension),
-                                                        pattern);
+    auto defaultDirectory = context.engine->getPropertyStorage().getDefaultLoadSaveDirectory ("editExport");
+    auto chooser = std::make_shared<juce::FileChooser> (splitExport ? "Choose a folder for the exported regions" : "Choose export destination",
+                                                        splitExport ? defaultDirectory
+                                                                    : defaultDirectory.getChildFile (baseName).withFileExtension (extension),
+                                                        splitExport ? juce::String() : pattern);
 
     auto enginePtr = context.engine;
     auto editPtr = context.edit;
     auto setStatus = context.setStatus;
+    auto isRecording = context.isRecording;
+    auto cache = renderCache;
+    auto regions = splitExport ? context.regions : std::vector<IAudioEngine::Region>();
 
-    chooser->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting,
-                          [chooser, fmtName, chosenRate, chosenDepth, oggQuality, bitrate, exportRange, enginePtr, editPtr, setStatus] (const juce::FileChooser&) mutable
+    const auto chooserFlags = splitExport ? juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories
+                                          : juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting;
+
+    chooser->launchAsync (chooserFlags,
+                          [chooser, fmtName, chosenRate, chosenDepth, oggQuality, bitrate, resamplerQuality, exportRange, enginePtr, editPtr, setStatus, isRecording, cache,
+                           regions, jobLimit, baseName, extension] (const juce::FileChooser&) mutable
                           {
                               auto f = chooser->getResult();
                               if (f == juce::File() || enginePtr == nullptr || editPtr == nullptr)
                                   return;
 
+                              if (isRecording != nullptr && isRecording())
+                              {
+                                  if (setStatus)
+                                      setStatus ("Stop recording before exporting");
+                                  return;
+                              }
+
                               auto& transport = editPtr->getTransport();
                               if (transport.isPlaying())
                                   transport.stop (false, true);
@@ -178,7 +507,7 @@ void AudioExporter::showExportDialog (const ExportContext& context)
 
                               editPtr->flushState();
 
-                              enginePtr->getPropertyStorage().setDefaultLoadSaveDirectory ("editExport", f.getParentDirectory());
+                              enginePtr->getPropertyStorage().setDefaultLoadSaveDirectory ("editExport", regions.empty() ? f.getParentDirectory() : f);
                               if (setStatus)
                                   setStatus ("Exporting...");
 
@@ -203,10 +532,91 @@ void AudioExporter::showExportDialog (const ExportContext& context)
                               params.ditheringEnabled = params.bitDepth < 32 && ! (isOgg || isMp3 || isM4a);
 
                               std::unique_ptr<juce::AudioFormat> ownedFormat (params.audioFormat);
-                              auto rendered = te::Renderer::renderToFile ("Exporting", params);
+
+                              // The edit renders at the device rate; any other export rate goes through the
+                              // resampler rather than running the whole graph at the export rate.
+                              auto nativeRate = enginePtr->getDeviceManager().getSampleRate();
+                              if (nativeRate <= 0.0)
+                                  nativeRate = params.sampleRateForAudio;
+
+                              const bool useResampler = std::abs (params.sampleRateForAudio - nativeRate) > 0.5;
+
+                              if (! regions.empty())
+                              {
+                                  std::vector<SplitExportJob::Item> items;
+                                  for (size_t i = 0; i < regions.size(); ++i)
+                                      items.push_back ({ regions[i].range, getRegionFile (f, baseName, (int) i, (int) regions.size(),
+                                                                                          regions[i].name, extension) });
+
+                                  SplitExportJob job (*editPtr, params, fmtName, std::move (items), jobLimit,
+                                                      nativeRate, resamplerQuality, cache);
+                                  enginePtr->getUIBehaviour().runTaskWithProgressBar (job);
+
+                                  if (setStatus)
+                                  {
+                                      juce::String status;
+                                      status << "Exported " << job.getNumSucceeded() << " of " << (int) regions.size()
+                                             << " regions to " << f.getFileName();
+
+                                      if (job.getNumFromCache() > 0)
+                                          status << " (" << job.getNumFromCache() << " cached)";
+
+                                      setStatus (status);
+                                  }
+
+                                  return;
+                              }
+
+                              // An identical render (same tracks, plugins, range and settings) can be copied from the cache.
+                              juce::String cacheKey;
+                              if (cache != nullptr)
+                              {
+                                  cacheKey = createRenderKey (*editPtr, params, fmtName, useResampler ? nativeRate : 0.0, resamplerQuality);
+                                  auto cached = cache->find (cacheKey, f.getFileExtension());
+
+                                  if (cached.existsAsFile() && cached.copyFileTo (f))
+                                  {
+                                      if (setStatus)
+                                          setStatus ("Exported to " + f.getFileName() + " (cached render)");
+                                      return;
+                                  }
+                              }
+
+                              juce::File rendered;
+
+                              if (useResampler)
+                              {
+                                  // Render a float WAV at the native rate, then resample and encode it in one pass.
+                                  juce::TemporaryFile intermediate (".wav");
+                                  juce::WavAudioFormat floatWav;
+
+                                  te::Renderer::Parameters nativeParams (params);
+                                  nativeParams.destFile = intermediate.getFile();
+                                  nativeParams.audioFormat = &floatWav;
+                                  nativeParams.sampleRateForAudio = nativeRate;
+                                  nativeParams.bitDepth = 32;
+                                  nativeParams.quality = 0;
+                                  nativeParams.ditheringEnabled = false;
+
+                                  if (te::Renderer::renderToFile ("Exporting", nativeParams).existsAsFile())
+                                  {
+                                      ResampleJob job (intermediate.getFile(), f, *ownedFormat, params, resamplerQuality, params.sampleRateForAudio);
+                                      enginePtr->getUIBehaviour().runTaskWithProgressBar (job);
+
+                                      if (job.succeeded)
+                                          rendered = f;
+                                  }
+                              }
+                              else
+                              {
+                                  rendered = te::Renderer::renderToFile ("Exporting", params);
+                              }
 
                               if (rendered.existsAsFile())
                               {
+                                  if (cache != nullptr)
+                                      cache->store (cacheKey, rendered);
+
                                   if (setStatus)
                                       setStatus ("Exported to " + f.getFileName());
                               }
@@ -217,3 +627,75 @@ void AudioExporter::showExportDialog (const ExportContext& context)
                               }
                           });
 }
+
+bool AudioExporter::exportRange (const ExportContext& context, te::TimeRange range, const juce::File& dest, juce::String& statusOut)
+{
+    if (context.edit == nullptr || context.engine == nullptr || range.isEmpty())
+    {
+        statusOut = "Nothing to export";
+        return false;
+    }
+
+    if (context.isRecording != nullptr && context.isRecording())
+    {
+        statusOut = "Stop recording before exporting";
+        return false;
+    }
+
+    auto format = createFormatForFile (dest);
+    if (format == nullptr)
+    {
+        statusOut = "Unsupported export format: " + dest.getFileExtension();
+        return false;
+    }
+
+    auto& transport = context.edit->getTransport();
+    if (transport.isPlaying())
+        transport.stop (false, true);
+    if (transport.isPlayContextActive())
+        transport.freePlaybackContext();
+
+    context.edit->flushState();
+
+    const bool isPcm = ! format->isCompressed();
+    const auto deviceRate = context.engine->getDeviceManager().getSampleRate();
+
+    te::Renderer::Parameters params (*context.engine);
+    params.edit = context.edit;
+    params.destFile = dest;
+    params.audioFormat = format.get();
+    params.tracksToDo = te::toBitSet (te::getAllTracks (*context.edit));
+    params.time = range;
+    params.sampleRateForAudio = context.renderSampleRate > 0.0 ? context.renderSampleRate
+                              : deviceRate > 0.0 ? deviceRate : 44100.0;
+    params.blockSizeForAudio = context.renderBlockSize > 0 ? context.renderBlockSize
+                                                           : context.engine->getDeviceManager().getBlockSize();
+    params.bitDepth = isPcm ? 24 : 16;
+    params.quality = isPcm ? 0 : format->getQualityOptions().size() / 2;
+    params.ditheringEnabled = isPcm;
+
+    juce::String cacheKey;
+    if (renderCache != nullptr)
+    {
+        cacheKey = createRenderKey (*context.edit, params, format->getFormatName(), 0.0, SampleRateConverter::Quality::high);
+        auto cached = renderCache->find (cacheKey, dest.getFileExtension());
+
+        if (cached.existsAsFile() && cached.copyFileTo (dest))
+        {
+            statusOut = "Exported to " + dest.getFileName() + " (cached render)";
+            return true;
+        }
+    }
+
+    if (! te::Renderer::renderToFile ("Exporting", params).existsAsFile())
+    {
+        statusOut = "Export failed";
+        return false;
+    }
+
+    if (renderCache != nullptr)
+        renderCache->store (cacheKey, dest);
+
+    statusOut = "Exported to " + dest.getFileName();
+    return true;
+}
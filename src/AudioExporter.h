@@ -3,6 +3,7 @@
 #include <JuceHeader.h>
 #include <tracktion_engine/tracktion_engine.h>
 #include "AudioEngine.h"
+#include "RenderCache.h"
 
 namespace te = tracktion;
 
@@ -13,8 +14,12 @@ struct ExportContext
     te::TimeRange selectionRange {};
     te::TimeRange fullRange {};
     bool hasSelection = false;
+    std::vector<IAudioEngine::Region> regions;      // offered as a split export when not empty
     juce::String defaultName;
     std::function<void (const juce::String&)> setStatus;
+    std::function<bool()> isRecording;              // exports are refused while true, as they free the playback context
+    double renderSampleRate = 0.0;                  // exportRange() only; 0 follows the device
+    int renderBlockSize = 0;                        // exportRange() only; 0 follows the device
 };
 
 class IAudioExporter
@@ -22,13 +27,24 @@ class IAudioExporter
 public:
     virtual ~IAudioExporter() = default;
     virtual void showExportDialog (const ExportContext& context) = 0;
+
+    /** Renders range to dest without asking anything, for scripted use. The format follows
+        dest's extension; PCM formats are written at 24 bits. The sample rate and block size
+        are the context's render settings when given, otherwise the device's.
+    */
+    virtual bool exportRange (const ExportContext& context, te::TimeRange range, const juce::File& dest, juce::String& statusOut) = 0;
 };
 
 class AudioExporter : public IAudioExporter
 {
 public:
-    AudioExporter() = default;
+    /** Renders are looked up in, and stored to, cacheToUse when one is given. */
+    explicit AudioExporter (RenderCache* cacheToUse = nullptr);
     ~AudioExporter() override = default;
 
     void showExportDialog (const ExportContext& context) override;
+    bool exportRange (const ExportContext& context, te::TimeRange range, const juce::File& dest, juce::String& statusOut) override;
+
+private:
+    RenderCache* renderCache = nullptr;
 };
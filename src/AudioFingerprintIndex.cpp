@@ -0,0 +1,316 @@
+#include "AudioFingerprintIndex.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+struct AudioFingerprintIndex::Build
+{
+    juce::File source;
+    double sampleRate = 0.0;
+    int generation = 0;
+    std::vector<std::vector<Landmark>> chunkResults;
+    std::atomic<int> remaining { 0 };
+};
+
+class AudioFingerprintIndex::ChunkJob : public juce::ThreadPoolJob
+{
+public:
+    ChunkJob (AudioFingerprintIndex& ownerRef, std::shared_ptr<Build> buildToFill, size_t chunk,
+              juce::uint32 first, juce::uint32 end, juce::uint32 total)
+        : juce::ThreadPoolJob ("Fingerprint chunk"),
+          owner (ownerRef), build (std::move (buildToFill)), chunkIndex (chunk),
+          firstFrame (first), endFrame (end), totalFrames (total)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        if (owner.buildGeneration.load() == build->generation)
+        {
+            // Each chunk opens its own reader so chunks can decode concurrently.
+            std::unique_ptr<juce::AudioFormatReader> reader (owner.formatManager.createReaderFor (build->source));
+
+            auto shouldStop = [this] { return shouldExit() || owner.buildGeneration.load() != build->generation; };
+
+            if (reader != nullptr)
+                build->chunkResults[chunkIndex] = analyseFrames (*reader, firstFrame, endFrame, totalFrames, shouldStop);
+        }
+
+        if (build->remaining.fetch_sub (1) == 1)
+            owner.publish (build);
+
+        return jobHasFinished;
+    }
+
+private:
+    AudioFingerprintIndex& owner;
+    std::shared_ptr<Build> build;
+    const size_t chunkIndex;
+    const juce::uint32 firstFrame, endFrame, totalFrames;
+};
+
+AudioFingerprintIndex::AudioFingerprintIndex (juce::AudioFormatManager& formats)
+    : formatManager (formats),
+      pool (juce::jmax (1, juce::SystemStats::getNumCpus() - 1))
+{
+}
+
+AudioFingerprintIndex::~AudioFingerprintIndex()
+{
+    ++buildGeneration;
+    pool.removeAllJobs (true, 5000);
+}
+
+void AudioFingerprintIndex::clear()
+{
+    // Queued chunks are dropped and running ones stop at their next frame; nothing waits for
+    // them, since the generation check keeps a stale build from being published.
+    ++buildGeneration;
+    pool.removeAllJobs (true, 0);
+
+    const juce::ScopedLock sl (indexLock);
+    index.reset();
+}
+
+bool AudioFingerprintIndex::isReady() const
+{
+    return getIndex() != nullptr;
+}
+
+std::shared_ptr<const AudioFingerprintIndex::Index> AudioFingerprintIndex::getIndex() const
+{
+    const juce::ScopedLock sl (indexLock);
+    return index;
+}
+
+void AudioFingerprintIndex::build (const juce::File& source)
+{
+    clear();
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (source));
+    if (reader == nullptr || reader->lengthInSamples < fftSize)
+        return;
+
+    auto newBuild = std::make_shared<Build>();
+    newBuild->source = source;
+    newBuild->sampleRate = reader->sampleRate;
+    newBuild->generation = buildGeneration.load();
+
+    const auto totalFrames = (juce::uint32) ((reader->lengthInSamples - fftSize) / hopSize + 1);
+    const auto framesPerChunk = std::max<juce::uint32> (1024, totalFrames / (juce::uint32) (juce::SystemStats::getNumCpus() * 4) + 1);
+    const auto numChunks = (size_t) ((totalFrames + framesPerChunk - 1) / framesPerChunk);
+
+    newBuild->chunkResults.resize (numChunks);
+    newBuild->remaining = (int) numChunks;
+
+    for (size_t i = 0; i < numChunks; ++i)
+    {
+        const auto first = (juce::uint32) i * framesPerChunk;
+        pool.addJob (new ChunkJob (*this, newBuild, i, first, std::min (totalFrames, first + framesPerChunk), totalFrames), true);
+    }
+}
+
+std::vector<AudioFingerprintIndex::Landmark> AudioFingerprintIndex::analyseFrames (juce::AudioFormatReader& reader, juce::uint32 firstFrame,
+                                                                                   juce::uint32 endFrame, juce::uint32 totalFrames,
+                                                                                   const std::function<bool()>& shouldStop)
+{
+    constexpr int minBin = 8, maxBin = fftSize / 2, neighbourhood = 3;
+
+    const auto lastPeakFrame = std::min (endFrame + (juce::uint32) targetFrames, totalFrames);
+    std::vector<std::array<int, peaksPerFrame>> peaks (lastPeakFrame - firstFrame);
+
+    juce::dsp::FFT fft (fftOrder);
+    juce::dsp::WindowingFunction<float> window ((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    juce::AudioBuffer<float> block ((int) reader.numChannels, fftSize);
+    juce::HeapBlock<float> fftData ((size_t) fftSize * 2);
+    const auto numChannels = block.getNumChannels();
+
+    for (auto frame = firstFrame; frame < lastPeakFrame; ++frame)
+    {
+        if (shouldStop())
+            return {};
+
+        auto& framePeaks = peaks[frame - firstFrame];
+        framePeaks.fill (-1);
+
+        reader.read (&block, 0, fftSize, (juce::int64) frame * hopSize, true, true);
+
+        juce::FloatVectorOperations::clear (fftData.get(), fftSize * 2);
+        for (int ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::addWithMultiply (fftData.get(), block.getReadPointer (ch), 1.0f / (float) numChannels, fftSize);
+
+        window.multiplyWithWindowingTable (fftData.get(), (size_t) fftSize);
+        fft.performFrequencyOnlyForwardTransform (fftData.get());
+
+        float mean = 0.0f;
+        for (int bin = minBin; bin < maxBin; ++bin)
+            mean += fftData[bin];
+        mean /= (float) (maxBin - minBin);
+
+        // Keep the strongest local maxima that stand well clear (~10 dB) of the frame's average level.
+        std::array<float, peaksPerFrame> peakLevels {};
+
+        for (int bin = minBin + neighbourhood; bin < maxBin - neighbourhood; ++bin)
+        {
+            const auto level = fftData[bin];
+            if (level < mean * 3.16f || level <= 0.0f)
+                continue;
+
+            bool isMaximum = true;
+            for (int n = bin - neighbourhood; n <= bin + neighbourhood && isMaximum; ++n)
+                isMaximum = n == bin || fftData[n] < level;
+
+            if (! isMaximum)
+                continue;
+
+            auto weakest = std::min_element (peakLevels.begin(), peakLevels.end());
+            if (level > *weakest)
+            {
+                framePeaks[(size_t) std::distance (peakLevels.begin(), weakest)] = bin;
+                *weakest = level;
+            }
+        }
+    }
+
+    std::vector<Landmark> landmarks;
+    landmarks.reserve ((size_t) (endFrame - firstFrame) * peaksPerFrame * targetsPerAnchor);
+
+    for (auto frame = firstFrame; frame < endFrame; ++frame)
+    {
+        for (auto anchor : peaks[frame - firstFrame])
+        {
+            if (anchor < 0)
+                continue;
+
+            int numTargets = 0;
+
+            for (juce::uint32 dt = 1; dt < (juce::uint32) targetFrames && frame + dt < lastPeakFrame && numTargets < targetsPerAnchor; ++dt)
+            {
+                for (auto target : peaks[frame + dt - firstFrame])
+                {
+                    if (target < 0 || numTargets >= targetsPerAnchor)
+                        continue;
+
+                    // 9 bits per (halved) frequency bin and 6 bits of frame gap.
+                    const auto hash = ((juce::uint32) (anchor / 2) << 15) | ((juce::uint32) (target / 2) << 6) | dt;
+                    landmarks.push_back ({ hash, frame });
+                    ++numTargets;
+                }
+            }
+        }
+    }
+
+    return landmarks;
+}
+
+void AudioFingerprintIndex::publish (const std::shared_ptr<Build>& finished)
+{
+    if (finished->generation != buildGeneration.load())
+        return;
+
+    auto newIndex = std::make_shared<Index>();
+    newIndex->sampleRate = finished->sampleRate;
+
+    size_t total = 0;
+    for (auto& chunk : finished->chunkResults)
+        total += chunk.size();
+
+    newIndex->byFrame.reserve (total);
+    for (auto& chunk : finished->chunkResults)
+        newIndex->byFrame.insert (newIndex->byFrame.end(), chunk.begin(), chunk.end());
+
+    newIndex->byHash = newIndex->byFrame;
+    std::sort (newIndex->byHash.begin(), newIndex->byHash.end(),
+               [] (const Landmark& a, const Landmark& b) { return a.hash != b.hash ? a.hash < b.hash : a.frame < b.frame; });
+
+    const juce::ScopedLock sl (indexLock);
+
+    if (finished->generation == buildGeneration.load())
+        index = std::move (newIndex);
+}
+
+std::vector<AudioFingerprintIndex::SourceMatch> AudioFingerprintIndex::findMatches (const std::vector<juce::Range<double>>& querySourceSeconds) const
+{
+    auto idx = getIndex();
+    if (idx == nullptr || idx->byFrame.empty())
+        return {};
+
+    const auto framesPerSecond = idx->sampleRate / hopSize;
+
+    struct QueryLandmark
+    {
+        juce::uint32 hash;
+        double framesFromQueryStart;
+    };
+
+    std::vector<QueryLandmark> query;
+    std::vector<juce::Range<juce::int64>> queryFrames;
+    double queryLengthFrames = 0.0;
+
+    for (auto& r : querySourceSeconds)
+    {
+        const auto first = (juce::int64) std::ceil (r.getStart() * framesPerSecond);
+        const auto end = (juce::int64) std::floor (r.getEnd() * framesPerSecond);
+        queryFrames.push_back ({ first, std::max (first, end) });
+
+        auto it = std::lower_bound (idx->byFrame.begin(), idx->byFrame.end(), first,
+                                    [] (const Landmark& l, juce::int64 f) { return (juce::int64) l.frame < f; });
+
+        for (; it != idx->byFrame.end() && (juce::int64) it->frame < end; ++it)
+            query.push_back ({ it->hash, queryLengthFrames + (double) ((juce::int64) it->frame - first) });
+
+        queryLengthFrames += r.getLength() * framesPerSecond;
+    }
+
+    if (query.empty())
+        return {};
+
+    auto isInsideQuery = [&queryFrames] (juce::int64 frame)
+    {
+        for (auto& r : queryFrames)
+            if (r.contains (frame))
+                return true;
+
+        return false;
+    };
+
+    // Each matching landmark votes for where the repeated region would start; votes are
+    // bucketed in pairs of frames to tolerate small timing jitter.
+    std::unordered_map<juce::int64, int> votes;
+
+    for (auto& q : query)
+    {
+        auto range = std::equal_range (idx->byHash.begin(), idx->byHash.end(), Landmark { q.hash, 0 },
+                                       [] (const Landmark& a, const Landmark& b) { return a.hash < b.hash; });
+
+        for (auto it = range.first; it != range.second; ++it)
+            if (! isInsideQuery ((juce::int64) it->frame))
+                ++votes[(juce::int64) std::llround ((double) it->frame - q.framesFromQueryStart) / 2];
+    }
+
+    std::vector<std::pair<juce::int64, int>> candidates (votes.begin(), votes.end());
+    std::sort (candidates.begin(), candidates.end(), [] (auto& a, auto& b) { return a.second > b.second; });
+
+    const auto minVotes = std::max (6, (int) query.size() / 20);
+    std::vector<SourceMatch> matches;
+
+    for (auto& [bucket, count] : candidates)
+    {
+        if (count < minVotes || matches.size() >= 20)
+            break;
+
+        const auto start = std::max (0.0, (double) (bucket * 2) / framesPerSecond);
+        const juce::Range<double> region (start, start + queryLengthFrames / framesPerSecond);
+
+        const bool overlapsBetterMatch = std::any_of (matches.begin(), matches.end(), [&region] (const SourceMatch& m)
+        {
+            return m.sourceSeconds.getIntersectionWith (region).getLength() > region.getLength() * 0.5;
+        });
+
+        if (! overlapsBetterMatch)
+            matches.push_back ({ region, count });
+    }
+
+    return matches;
+}
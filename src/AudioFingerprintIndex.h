@@ -0,0 +1,78 @@
+/*
+    Landmark fingerprint index over a source file.
+
+    Each analysis frame contributes its strongest spectral peaks; pairs of peaks close in
+    time are hashed (both frequencies plus the frame gap) into landmarks. Repeated
+    material produces the same landmarks at a constant frame offset, so a query votes on
+    offsets and the well-supported ones are reported as matches. Indexing is split into
+    chunks that run in parallel on a thread pool.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class AudioFingerprintIndex
+{
+public:
+    struct SourceMatch
+    {
+        juce::Range<double> sourceSeconds;
+        int votes = 0;
+    };
+
+    explicit AudioFingerprintIndex (juce::AudioFormatManager& formats);
+    ~AudioFingerprintIndex();
+
+    /** Starts indexing a source in the background, replacing any previous index. */
+    void build (const juce::File& source);
+    void clear();
+    bool isReady() const;
+
+    /** Finds other places in the source that sound like the query. The query is given as
+        the source ranges that make up a selection, in timeline order; matches that overlap
+        the query itself are ignored.
+    */
+    std::vector<SourceMatch> findMatches (const std::vector<juce::Range<double>>& querySourceSeconds) const;
+
+private:
+    struct Landmark
+    {
+        juce::uint32 hash = 0;
+        juce::uint32 frame = 0;
+    };
+
+    struct Index
+    {
+        double sampleRate = 0.0;
+        std::vector<Landmark> byFrame, byHash;
+    };
+
+    struct Build;
+    class ChunkJob;
+
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = 512;
+    static constexpr int peaksPerFrame = 3;
+    static constexpr int targetFrames = 32;
+    static constexpr int targetsPerAnchor = 3;
+
+    static std::vector<Landmark> analyseFrames (juce::AudioFormatReader&, juce::uint32 firstFrame, juce::uint32 endFrame,
+                                                juce::uint32 totalFrames, const std::function<bool()>& shouldStop);
+    void publish (const std::shared_ptr<Build>&);
+    std::shared_ptr<const Index> getIndex() const;
+
+    juce::AudioFormatManager& formatManager;
+    juce::ThreadPool pool;
+    std::atomic<int> buildGeneration { 0 };
+
+    mutable juce::CriticalSection indexLock;
+    std::shared_ptr<const Index> index;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioFingerprintIndex)
+};
@@ -0,0 +1,785 @@
+#include "ControlServer.h"
+#include <cstdlib>
+
+#if ! JUCE_WINDOWS
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <sys/stat.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+#endif
+
+using namespace tracktion::literals;
+
+namespace
+{
+   #if ! JUCE_WINDOWS
+    constexpr int pollIntervalMs = 100;
+
+   #if JUCE_LINUX
+    constexpr int sendFlags = MSG_NOSIGNAL;
+   #else
+    constexpr int sendFlags = 0;
+   #endif
+
+    bool makeAddress (const juce::File& path, sockaddr_un& address)
+    {
+        const auto name = path.getFullPathName().toStdString();
+        address = {};
+        address.sun_family = AF_UNIX;
+
+        if (name.size() >= sizeof (address.sun_path))
+            return false;
+
+        std::copy (name.begin(), name.end(), address.sun_path);
+        return true;
+    }
+
+    void configureSocket (int fd)
+    {
+       #ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt (fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof (on));
+       #else
+        juce::ignoreUnused (fd);
+       #endif
+    }
+
+    // True if something accepts connections at address, i.e. the socket there isn't stale.
+    bool isSocketLive (const sockaddr_un& address)
+    {
+        const auto fd = socket (AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+
+        const bool live = connect (fd, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) == 0;
+        close (fd);
+        return live;
+    }
+
+    // Waits up to pollIntervalMs for fd to become readable; false on timeout.
+    bool waitForData (int fd)
+    {
+        pollfd p { fd, POLLIN, 0 };
+        return poll (&p, 1, pollIntervalMs) > 0;
+    }
+
+    /** Reads newline-terminated messages from a socket, keeping whatever follows the last
+        newline for the next call. Returns false once the peer has closed the connection.
+    */
+    bool readLine (int fd, std::string& pending, juce::String& line, const std::function<bool()>& shouldStop)
+    {
+        for (;;)
+        {
+            if (const auto newline = pending.find ('\n'); newline != std::string::npos)
+            {
+                line = juce::String::fromUTF8 (pending.data(), (int) newline);
+                pending.erase (0, newline + 1);
+                return true;
+            }
+
+            if (shouldStop != nullptr && shouldStop())
+                return false;
+
+            if (! waitForData (fd))
+                continue;
+
+            char buffer[4096];
+            const auto numRead = recv (fd, buffer, sizeof (buffer), 0);
+            if (numRead <= 0)
+                return false;
+
+            pending.append (buffer, (size_t) numRead);
+        }
+    }
+
+    bool writeLine (int fd, const juce::String& text)
+    {
+        const auto data = text.toStdString() + "\n";
+
+        for (size_t written = 0; written < data.size();)
+        {
+            const auto numWritten = send (fd, data.data() + written, data.size() - written, sendFlags);
+            if (numWritten <= 0)
+                return false;
+
+            written += (size_t) numWritten;
+        }
+
+        return true;
+    }
+
+    int connectTo (const juce::File& path)
+    {
+        sockaddr_un address;
+        if (! makeAddress (path, address))
+            return -1;
+
+        const auto fd = socket (AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+
+        configureSocket (fd);
+
+        if (connect (fd, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0)
+        {
+            close (fd);
+            return -1;
+        }
+
+        return fd;
+    }
+   #endif
+
+    bool getSeconds (const juce::var& value, double& seconds)
+    {
+        if (! (value.isDouble() || value.isInt() || value.isInt64()))
+            return false;
+
+        seconds = (double) value;
+        return seconds >= 0.0;
+    }
+
+    juce::var createObject (std::initializer_list<std::pair<const char*, juce::var>> properties)
+    {
+        auto* object = new juce::DynamicObject();
+        for (auto& p : properties)
+            object->setProperty (p.first, p.second);
+
+        return object;
+    }
+}
+
+ControlServer::ControlServer (IAudioEngine& engineToControl, IAudioExporter& exporterToUse)
+    : juce::Thread ("Control socket"),
+      engine (engineToControl),
+      exporter (exporterToUse)
+{
+}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+juce::File ControlServer::getDefaultSocketFile()
+{
+    const juce::String socketName ("NonDestructiveEditor.sock");
+
+   #if JUCE_WINDOWS
+    return juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile (socketName);
+   #else
+    // $XDG_RUNTIME_DIR is already private to the user.
+    if (const auto* runtimeDir = std::getenv ("XDG_RUNTIME_DIR"); runtimeDir != nullptr && runtimeDir[0] == '/')
+        return juce::File (juce::CharPointer_UTF8 (runtimeDir)).getChildFile (socketName);
+
+    // Otherwise a folder of our own in the shared temp directory, which is only trusted if it
+    // really is ours and nobody else can get into it.
+    const auto dir = juce::File::getSpecialLocation (juce::File::tempDirectory)
+                       .getChildFile ("NonDestructiveEditor-" + juce::String ((juce::int64) getuid()));
+    const auto path = dir.getFullPathName();
+    mkdir (path.toRawUTF8(), S_IRWXU);
+
+    struct stat info;
+    if (lstat (path.toRawUTF8(), &info) != 0 || ! S_ISDIR (info.st_mode) || info.st_uid != getuid()
+         || (info.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+        return {};
+
+    return dir.getChildFile (socketName);
+   #endif
+}
+
+bool ControlServer::start (const juce::File& socketFile, juce::String& statusOut)
+{
+    stop();
+
+   #if JUCE_WINDOWS
+    juce::ignoreUnused (socketFile);
+    statusOut = "The control socket needs Unix-domain sockets, which this build doesn't support";
+    return false;
+   #else
+    sockaddr_un address;
+    if (! makeAddress (socketFile, address))
+    {
+        statusOut = "Socket path is too long: " + socketFile.getFullPathName();
+        return false;
+    }
+
+    // A socket left behind by a previous run would make bind() fail, but one that still
+    // accepts connections belongs to another instance and mustn't be taken over.
+    if (struct stat info; lstat (address.sun_path, &info) == 0)
+    {
+        if (! S_ISSOCK (info.st_mode) || isSocketLive (address))
+        {
+            statusOut = "Another process is using " + socketFile.getFullPathName();
+            return false;
+        }
+
+        unlink (address.sun_path);
+    }
+
+    listenSocket = socket (AF_UNIX, SOCK_STREAM, 0);
+
+    // The socket is created owner-only, so there's no moment when another user could connect.
+    const auto previousMask = umask (S_IRWXG | S_IRWXO);
+    const bool bound = listenSocket >= 0 && bind (listenSocket, reinterpret_cast<sockaddr*> (&address), sizeof (address)) == 0;
+    umask (previousMask);
+
+    if (! bound || listen (listenSocket, 4) != 0)
+    {
+        statusOut = "Couldn't listen on " + socketFile.getFullPathName();
+
+        if (listenSocket >= 0)
+            close (listenSocket);
+
+        listenSocket = -1;
+        return false;
+    }
+
+    socketPath = socketFile;
+    startThread();
+    statusOut = "Listening on " + socketFile.getFullPathName();
+    return true;
+   #endif
+}
+
+void ControlServer::stop()
+{
+    stopThread (2000);
+
+   #if ! JUCE_WINDOWS
+    if (listenSocket >= 0)
+    {
+        close (listenSocket);
+        listenSocket = -1;
+        socketPath.deleteFile();
+    }
+   #endif
+}
+
+void ControlServer::run()
+{
+   #if ! JUCE_WINDOWS
+    while (! threadShouldExit())
+    {
+        if (! waitForData (listenSocket))
+            continue;
+
+        const auto client = accept (listenSocket, nullptr, nullptr);
+        if (client < 0)
+            continue;
+
+        configureSocket (client);
+
+        // Clients are served one at a time; each is a script carrying out a sequence of edits.
+        serveClient (client);
+        close (client);
+    }
+   #endif
+}
+
+void ControlServer::serveClient (int clientSocket)
+{
+   #if ! JUCE_WINDOWS
+    struct PendingCall
+    {
+        juce::String request, response;
+        juce::WaitableEvent done;
+    };
+
+    std::string pending;
+    juce::String line;
+
+    while (readLine (clientSocket, pending, line, [this] { return threadShouldExit(); }))
+    {
+        if (line.trim().isEmpty())
+            continue;
+
+        auto call = std::make_shared<PendingCall>();
+        call->request = line;
+
+        juce::MessageManager::callAsync ([weakThis = juce::WeakReference<ControlServer> (this), call]
+        {
+            if (weakThis != nullptr)
+                call->response = weakThis->handleMessage (call->request);
+
+            call->done.signal();
+        });
+
+        while (! call->done.wait (pollIntervalMs))
+            if (threadShouldExit())
+                return;
+
+        if (call->response.isNotEmpty() && ! writeLine (clientSocket, call->response))
+            return;
+    }
+   #else
+    juce::ignoreUnused (clientSocket);
+   #endif
+}
+
+juce::String ControlServer::handleMessage (const juce::String& json)
+{
+    juce::var parsed;
+
+    if (juce::JSON::parse (json, parsed).failed())
+        return juce::JSON::toString (createResponse ({ {}, {}, parseError, "Parse error" }), true);
+
+    juce::var response;
+
+    if (auto* requests = parsed.getArray())
+        response = requests->isEmpty() ? createResponse ({ {}, {}, invalidRequest, "Empty batch" }) : handleBatch (*requests);
+    else
+        response = handleRequest (parsed);
+
+    return response.isVoid() ? juce::String() : juce::JSON::toString (response, true);
+}
+
+juce::var ControlServer::handleRequest (const juce::var& request)
+{
+    auto call = invoke (request, false);
+
+    // Requests without an id are notifications and get no response.
+    return request.hasProperty ("id") ? createResponse (call) : juce::var();
+}
+
+juce::var ControlServer::handleBatch (const juce::Array<juce::var>& requests)
+{
+    std::vector<Call> calls;
+    engine.beginBatch (std::nullopt);
+
+    for (auto& request : requests)
+    {
+        calls.push_back (invoke (request, true));
+
+        if (calls.back().error != noError)
+            break;
+    }
+
+    const bool failed = calls.back().error != noError;
+    engine.endBatch (! failed);
+
+    if (failed)
+    {
+        // Nothing in the batch took effect, including the requests that had succeeded.
+        for (size_t i = 0; i + 1 < calls.size(); ++i)
+            calls[i] = { calls[i].id, {}, rolledBack, "Rolled back" };
+
+        for (auto i = (int) calls.size(); i < requests.size(); ++i)
+            calls.push_back ({ requests[i]["id"], {}, rolledBack, "Not run" });
+    }
+
+    juce::Array<juce::var> responses;
+
+    for (int i = 0; i < (int) calls.size(); ++i)
+        if (requests[i].hasProperty ("id"))
+            responses.add (createResponse (calls[(size_t) i]));
+
+    return responses.isEmpty() ? juce::var() : juce::var (responses);
+}
+
+ControlServer::Call ControlServer::invoke (const juce::var& request, bool inBatch)
+{
+    Call call;
+    call.id = request["id"];
+
+    const auto method = request["method"].toString();
+
+    if (! request.isObject() || request["jsonrpc"].toString() != "2.0" || method.isEmpty())
+    {
+        call.error = invalidRequest;
+        call.message = "Invalid request";
+        return call;
+    }
+
+    // A batch is one edit, so it can only hold requests that edit or query the timeline.
+    static const juce::StringArray notInBatch { "load", "undo", "export" };
+
+    if (inBatch && notInBatch.contains (method))
+    {
+        call.error = invalidRequest;
+        call.message = "\"" + method + "\" can't be part of a batch";
+        return call;
+    }
+
+    call.error = callMethod (method, request["params"], call.result, call.message);
+    return call;
+}
+
+int ControlServer::callMethod (const juce::String& method, const juce::var& params, juce::var& result, juce::String& message)
+{
+    juce::String status;
+
+    if (method == "load")
+    {
+        const auto path = params["path"].toString();
+        if (path.isEmpty() || ! juce::File::isAbsolutePath (path))
+        {
+            message = "\"path\" must be an absolute path";
+            return invalidParams;
+        }
+
+        if (! engine.loadFile (juce::File (path), status))
+        {
+            message = status;
+            return operationFailed;
+        }
+
+        selection.clear();
+        result = engine.getTotalLength().inSeconds();
+        return noError;
+    }
+
+    if (method == "getLength")
+    {
+        result = engine.getTotalLength().inSeconds();
+        return noError;
+    }
+
+    if (method == "getSegments")
+    {
+        juce::Array<juce::var> segments;
+        double start = 0.0;
+
+        for (auto& seg : engine.getSegments())
+        {
+            segments.add (createObject ({ { "start", start },
+                                          { "length", seg.length.inSeconds() },
+                                          { "sourceOffset", seg.sourceOffset.inSeconds() },
+                                          { "source", seg.source.getFullPathName() } }));
+            start += seg.length.inSeconds();
+        }
+
+        result = segments;
+        return noError;
+    }
+
+    if (method == "select")
+    {
+        SelectionSet ranges;
+        if (! getRanges (params, ranges, message))
+            return invalidParams;
+
+        selection = ranges;
+        result = selection.getTotalLength().inSeconds();
+        return noError;
+    }
+
+    if (method == "setInsertionPoint" || method == "paste")
+    {
+        auto position = engine.getInsertionPoint().inSeconds();
+
+        if (params.hasProperty ("position") && ! getSeconds (params["position"], position))
+        {
+            message = "\"position\" must be a time in seconds";
+            return invalidParams;
+        }
+
+        const auto pos = te::TimePosition::fromSeconds (position);
+
+        if (method == "setInsertionPoint")
+        {
+            engine.setInsertionPoint (pos);
+            result = engine.getInsertionPoint().inSeconds();
+            return noError;
+        }
+
+        if (! engine.hasClipboard())
+        {
+            message = "The clipboard is empty";
+            return operationFailed;
+        }
+
+        engine.pushUndoState (std::nullopt, pos);
+        engine.pasteClipboard (pos);
+        result = engine.getTotalLength().inSeconds();
+        return noError;
+    }
+
+    if (method == "copy" || method == "cut" || method == "delete" || method == "normalise")
+    {
+        SelectionSet ranges;
+        if (! getRanges (params, ranges, message))
+            return invalidParams;
+
+        bool ok = false;
+
+        if (method == "copy")
+        {
+            ok = engine.copySelections (ranges);
+        }
+        else
+        {
+            engine.pushUndoState (ranges.getBounds(), ranges.getBounds().getStart());
+
+            if (method == "cut")
+                ok = engine.cutSelections (ranges);
+            else if (method == "delete")
+                ok = engine.deleteSelections (ranges);
+            else
+                ok = engine.normaliseSelections (ranges, status);
+        }
+
+        if (! ok)
+        {
+            message = status.isNotEmpty() ? status : "Nothing to " + method;
+            return operationFailed;
+        }
+
+        // Ranges given to "select" refer to the timeline before the edit.
+        if (method != "copy")
+            selection.clear();
+
+        result = engine.getTotalLength().inSeconds();
+        return noError;
+    }
+
+    if (method == "undo")
+    {
+        std::optional<te::TimeRange> restoredSelection;
+        te::TimePosition insertion;
+
+        if (! engine.undo (restoredSelection, insertion))
+        {
+            message = "Nothing to undo";
+            return operationFailed;
+        }
+
+        engine.setInsertionPoint (insertion);
+        selection = restoredSelection.has_value() ? SelectionSet (*restoredSelection) : SelectionSet();
+        result = engine.getTotalLength().inSeconds();
+        return noError;
+    }
+
+    if (method == "export")
+    {
+        const auto path = params["path"].toString();
+        if (path.isEmpty() || ! juce::File::isAbsolutePath (path))
+        {
+            message = "\"path\" must be an absolute path";
+            return invalidParams;
+        }
+
+        const auto fullRange = te::TimeRange { 0_tp, 0_tp + engine.getTotalLength() };
+        auto range = fullRange;
+
+        if (params.hasProperty ("ranges"))
+        {
+            SelectionSet ranges;
+            if (! getRanges (params, ranges, message))
+                return invalidParams;
+
+            range = ranges.getBounds();
+        }
+
+        ExportContext context;
+        context.engine = &engine.getEngine();
+        context.edit = engine.getEdit();
+        context.fullRange = fullRange;
+        context.isRecording = [this] { return engine.isRecording(); };
+
+        if (! exporter.exportRange (context, range, juce::File (path), status))
+        {
+            message = status;
+            return operationFailed;
+        }
+
+        result = path;
+        return noError;
+    }
+
+    message = "Unknown method \"" + method + "\"";
+    return methodNotFound;
+}
+
+bool ControlServer::getRanges (const juce::var& params, SelectionSet& ranges, juce::String& message) const
+{
+    if (! params.hasProperty ("ranges"))
+    {
+        ranges = selection;
+
+        if (ranges.isEmpty())
+            message = "No \"ranges\" given and nothing selected";
+
+        return ! ranges.isEmpty();
+    }
+
+    auto* list = params["ranges"].getArray();
+    if (list == nullptr)
+    {
+        message = "\"ranges\" must be an array of [start, end] pairs";
+        return false;
+    }
+
+    const auto total = engine.getTotalLength().inSeconds();
+
+    for (auto& item : *list)
+    {
+        double start = 0.0, end = 0.0;
+        auto* pair = item.getArray();
+
+        if (pair == nullptr || pair->size() != 2 || ! getSeconds ((*pair)[0], start) || ! getSeconds ((*pair)[1], end)
+             || end <= start || end > total)
+        {
+            message = "Each range must be [start, end] in seconds, within the timeline";
+            return false;
+        }
+
+        ranges.add ({ te::TimePosition::fromSeconds (start), te::TimePosition::fromSeconds (end) });
+    }
+
+    return true;
+}
+
+juce::var ControlServer::createResponse (const Call& call)
+{
+    if (call.error == noError)
+        return createObject ({ { "jsonrpc", "2.0" }, { "id", call.id }, { "result", call.result } });
+
+    return createObject ({ { "jsonrpc", "2.0" }, { "id", call.id },
+                           { "error", createObject ({ { "code", call.error }, { "message", call.message } }) } });
+}
+
+juce::String ControlServer::runBenchmark (IAudioEngine& engine, IAudioExporter& exporter)
+{
+   #if JUCE_WINDOWS
+    juce::ignoreUnused (engine, exporter);
+    return "The control socket isn't supported on this platform\n";
+   #else
+    constexpr double sampleRate = 44100.0, lengthSeconds = 60.0;
+    constexpr int numSingleCommands = 300, numBatches = 30, commandsPerBatch = 10;
+
+    // A minute of stereo tone to edit; the benchmark only moves segments around.
+    juce::TemporaryFile source (".wav");
+    {
+        juce::WavAudioFormat wav;
+        auto out = source.getFile().createOutputStream();
+        std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? wav.createWriterFor (out.get(), sampleRate, 2, 24, {}, 0)
+                                                                        : nullptr);
+        if (writer == nullptr)
+            return "Couldn't write the benchmark source\n";
+
+        out.release();
+
+        juce::AudioBuffer<float> buffer (2, (int) sampleRate);
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            buffer.setSample (0, i, 0.25f * std::sin (juce::MathConstants<float>::twoPi * 440.0f * (float) i / (float) sampleRate));
+        buffer.copyFrom (1, 0, buffer, 0, 0, buffer.getNumSamples());
+
+        for (int second = 0; second < (int) lengthSeconds; ++second)
+            writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+    }
+
+    juce::String status;
+    if (! engine.createNewEdit ("RPC benchmark") || ! engine.loadFile (source.getFile(), status))
+        return "Couldn't load the benchmark source: " + status + "\n";
+
+    const auto socketFile = juce::File::getSpecialLocation (juce::File::tempDirectory)
+                              .getChildFile ("rpc-benchmark-" + juce::String::toHexString (juce::Random::getSystemRandom().nextInt()) + ".sock");
+
+    ControlServer server (engine, exporter);
+    if (! server.start (socketFile, status))
+        return status + "\n";
+
+    // Each command is a copy, paste or delete of one second, so the timeline length stays put.
+    auto createCommand = [] (int index, int id)
+    {
+        static const char* const commands[] =
+        {
+            R"("method":"copy","params":{"ranges":[[10,11]]})",
+            R"("method":"paste","params":{"position":20})",
+            R"("method":"delete","params":{"ranges":[[20,21]]})"
+        };
+
+        return juce::String (R"({"jsonrpc":"2.0","id":)") + juce::String (id) + "," + commands[index % 3] + "}";
+    };
+
+    struct Client : public juce::Thread
+    {
+        Client() : juce::Thread ("RPC benchmark client") {}
+
+        void run() override
+        {
+            const auto fd = connectTo (path);
+            if (fd < 0)
+                return;
+
+            std::string pending;
+            juce::String response;
+
+            for (auto& request : requests)
+            {
+                const auto start = juce::Time::getHighResolutionTicks();
+
+                if (! writeLine (fd, request) || ! readLine (fd, pending, response, nullptr))
+                    break;
+
+                ++numAnswered;
+                if (response.contains ("\"error\""))
+                    ++numErrors;
+
+                elapsedTicks += juce::Time::getHighResolutionTicks() - start;
+            }
+
+            close (fd);
+        }
+
+        juce::File path;
+        juce::StringArray requests;
+        int numAnswered = 0, numErrors = 0;
+        juce::int64 elapsedTicks = 0;
+    };
+
+    auto runClient = [&] (const juce::StringArray& requests)
+    {
+        Client client;
+        client.path = socketFile;
+        client.requests = requests;
+        client.startThread();
+
+        // The server carries out requests on the message thread, so keep it running.
+        while (client.isThreadRunning())
+            juce::MessageManager::getInstance()->runDispatchLoopUntil (5);
+
+        return std::make_tuple (client.numAnswered, client.numErrors, juce::Time::highResolutionTicksToSeconds (client.elapsedTicks));
+    };
+
+    juce::StringArray singles, batches;
+
+    for (int i = 0; i < numSingleCommands; ++i)
+        singles.add (createCommand (i, i));
+
+    // Every batch starts with a copy, so its pastes don't depend on the batch before it.
+    for (int b = 0; b < numBatches; ++b)
+    {
+        juce::StringArray batch;
+        for (int i = 0; i < commandsPerBatch; ++i)
+            batch.add (createCommand (i, b * commandsPerBatch + i));
+
+        batches.add ("[" + batch.joinIntoString (",") + "]");
+    }
+
+    juce::String report ("Control socket benchmark\n");
+
+    auto addLine = [&report] (const juce::String& name, int numCommands, int numRequests, int numAnswered, int numErrors, double seconds)
+    {
+        report << name.paddedRight (' ', 18) << numCommands << " commands in " << juce::String (seconds, 3) << " s = "
+               << juce::String (numCommands / std::max (seconds, 1.0e-9), 1) << " commands/s, "
+               << juce::String (1000.0 * seconds / std::max (1, numRequests), 2) << " ms per request";
+
+        if (numAnswered < numRequests || numErrors > 0)
+            report << " (" << numAnswered << " of " << numRequests << " answered, " << numErrors << " errors)";
+
+        report << "\n";
+    };
+
+    const auto [singleAnswered, singleErrors, singleSeconds] = runClient (singles);
+    addLine ("single commands", numSingleCommands, numSingleCommands, singleAnswered, singleErrors, singleSeconds);
+
+    const auto [batchAnswered, batchErrors, batchSeconds] = runClient (batches);
+    addLine ("batches of " + juce::String (commandsPerBatch), numBatches * commandsPerBatch, numBatches, batchAnswered, batchErrors, batchSeconds);
+
+    server.stop();
+    return report;
+   #endif
+}
@@ -0,0 +1,87 @@
+/*
+    Local control socket for driving the editor from scripts.
+
+    Listens on a Unix-domain socket for JSON-RPC 2.0 requests, one per line. Each request
+    is carried out on the message thread exactly like the matching UI action. A JSON array
+    of requests is a batch: it is applied as one edit, with one track rebuild and one undo
+    step, and is rolled back as a whole if any request in it fails.
+
+    Methods: load, getLength, getSegments, select, setInsertionPoint, copy, cut, delete,
+    paste, normalise, undo and export. Edit methods take "ranges" ([[start, end], ...] in
+    seconds) and fall back to the ranges given to the last "select".
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioEngine.h"
+#include "AudioExporter.h"
+#include "SelectionSet.h"
+
+class ControlServer : private juce::Thread
+{
+public:
+    ControlServer (IAudioEngine& engineToControl, IAudioExporter& exporterToUse);
+    ~ControlServer() override;
+
+    /** Starts listening on socketFile, which only the current user can connect to. A stale
+        socket left there is replaced; one that another instance still listens on isn't, and
+        start() fails instead.
+    */
+    bool start (const juce::File& socketFile, juce::String& statusOut);
+    void stop();
+    bool isListening() const                        { return isThreadRunning(); }
+
+    /** The socket used when no path is given: in $XDG_RUNTIME_DIR, or else in a per-user folder
+        in the temp directory that only its owner can enter. Empty if that folder isn't safe.
+    */
+    static juce::File getDefaultSocketFile();
+
+    /** Handles one request or batch and returns the response (empty for notifications).
+        Call from the message thread.
+    */
+    juce::String handleMessage (const juce::String& json);
+
+    /** Loads a generated file and measures round trips through the socket, one command at
+        a time and in batches. Needs the message loop, so call it from the message thread.
+    */
+    static juce::String runBenchmark (IAudioEngine&, IAudioExporter&);
+
+private:
+    enum ErrorCode
+    {
+        noError         = 0,
+        parseError      = -32700,
+        invalidRequest  = -32600,
+        methodNotFound  = -32601,
+        invalidParams   = -32602,
+        operationFailed = -32000,
+        rolledBack      = -32001
+    };
+
+    struct Call
+    {
+        juce::var id, result;
+        int error = noError;
+        juce::String message;
+    };
+
+    void run() override;
+    void serveClient (int clientSocket);
+
+    juce::var handleRequest (const juce::var& request);
+    juce::var handleBatch (const juce::Array<juce::var>& requests);
+    Call invoke (const juce::var& request, bool inBatch);
+    int callMethod (const juce::String& method, const juce::var& params, juce::var& result, juce::String& message);
+    bool getRanges (const juce::var& params, SelectionSet& ranges, juce::String& message) const;
+    static juce::var createResponse (const Call&);
+
+    IAudioEngine& engine;
+    IAudioExporter& exporter;
+    SelectionSet selection;
+    juce::File socketPath;
+    int listenSocket = -1;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (ControlServer)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ControlServer)
+};
@@ -0,0 +1,140 @@
+/*
+    Headless check that steady-state cut, paste and undo stay off the heap.
+
+    Built as its own executable because it replaces the global operator new to count
+    allocations; the application keeps the standard allocator. Loads a generated file,
+    repeats cut / paste / undo / undo, and exits with 1 if any allocation was made by the
+    segment edits once the scratch buffers and undo states have reached their working size.
+*/
+
+#include "AllocationCounter.h"
+#include "AudioEngine.h"
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+void* operator new (std::size_t size)
+{
+    AllocationCounter::noteAllocation();
+
+    if (auto* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)                     { return ::operator new (size); }
+void operator delete (void* p) noexcept                     { std::free (p); }
+void operator delete[] (void* p) noexcept                   { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept        { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept      { std::free (p); }
+
+namespace
+{
+    bool runEditCycles (IAudioEngine& engine, juce::String& report)
+    {
+        using namespace tracktion::literals;
+
+        constexpr double sampleRate = 44100.0, lengthSeconds = 60.0;
+        constexpr int warmUpCycles = 30, measuredCycles = 200;
+
+        // A minute of stereo tone to edit; only the segments are moved around.
+        juce::TemporaryFile source (".wav");
+        {
+            juce::WavAudioFormat wav;
+            auto out = source.getFile().createOutputStream();
+            std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? wav.createWriterFor (out.get(), sampleRate, 2, 24, {}, 0)
+                                                                            : nullptr);
+            if (writer == nullptr)
+            {
+                report << "Couldn't write the test source\n";
+                return false;
+            }
+
+            out.release();
+
+            juce::AudioBuffer<float> buffer (2, (int) sampleRate);
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (0, i, 0.25f * std::sin (juce::MathConstants<float>::twoPi * 440.0f * (float) i / (float) sampleRate));
+            buffer.copyFrom (1, 0, buffer, 0, 0, buffer.getNumSamples());
+
+            for (int second = 0; second < (int) lengthSeconds; ++second)
+                writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+        }
+
+        juce::String status;
+        if (! engine.createNewEdit ("Allocation count") || ! engine.loadFile (source.getFile(), status))
+        {
+            report << "Couldn't load the test source: " << status << "\n";
+            return false;
+        }
+
+        // Each cycle ends where it started, so the buffers settle at a fixed size. Undo states
+        // are pushed before each edit, as the editor and the control socket do.
+        auto runCycle = [&engine]
+        {
+            const IAudioEngine::TimeRange cut { 10_tp, 11_tp };
+            std::optional<IAudioEngine::TimeRange> selection;
+            IAudioEngine::TimePosition insertion;
+
+            engine.pushUndoState (cut, cut.getStart());
+            bool ok = engine.cutSelection (cut);
+            engine.pushUndoState (std::nullopt, 20_tp);
+            ok = engine.pasteClipboard (20_tp) && ok;
+            ok = engine.undo (selection, insertion) && ok;
+            return engine.undo (selection, insertion) && ok;
+        };
+
+        for (int i = 0; i < warmUpCycles; ++i)
+        {
+            if (! runCycle())
+            {
+                report << "An edit failed while warming up\n";
+                return false;
+            }
+        }
+
+        AllocationCounter counter;
+        bool allSucceeded = true;
+
+        for (int i = 0; i < measuredCycles; ++i)
+            allSucceeded = runCycle() && allSucceeded;
+
+        const auto counted = counter.getCount(), excluded = counter.getExcludedCount();
+
+        report << "Edit allocations over " << measuredCycles << " cut / paste / undo / undo cycles (after " << warmUpCycles << " to warm up)\n"
+               << "  segment edits and undo:  " << counted << " (" << juce::String ((double) counted / measuredCycles, 2) << " per cycle)\n"
+               << "  track rebuilds:          " << excluded << " (" << juce::String ((double) excluded / measuredCycles, 2) << " per cycle)\n";
+
+        if (! allSucceeded)
+        {
+            report << "FAILED: some edits failed, so the counts don't cover every step\n";
+            return false;
+        }
+
+        if (counted != 0)
+        {
+            report << "FAILED: segment edits allocated in the steady state\n";
+            return false;
+        }
+
+        report << "PASSED\n";
+        return true;
+    }
+}
+
+int main()
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::String report;
+    bool passed = false;
+
+    {
+        AudioEngine engine (false);
+        passed = runEditCycles (engine, report);
+    }
+
+    std::cout << report << std::flush;
+    return passed ? 0 : 1;
+}
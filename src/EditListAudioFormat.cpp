@@ -0,0 +1,238 @@
+#include "EditListAudioFormat.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const juce::String descriptionHeader ("TEDL 2");
+    const juce::String singleSourceHeader ("TEDL 1");
+
+    void clearDest (int* const* destChannels, int numDestChannels, int startOffset, int numSamples)
+    {
+        for (int ch = 0; ch < numDestChannels; ++ch)
+            if (destChannels[ch] != nullptr)
+                juce::zeromem (destChannels[ch] + startOffset, sizeof (int) * (size_t) numSamples);
+    }
+}
+
+EditListAudioFormatReader::EditListAudioFormatReader (std::vector<std::unique_ptr<juce::AudioFormatReader>> sourceReaders,
+                                                      const std::vector<Range>& rangesToPlay)
+    : juce::AudioFormatReader (nullptr, "Edit List"),
+      sources (std::move (sourceReaders))
+{
+    jassert (! sources.empty());
+
+    sampleRate = sources.front()->sampleRate;
+    bitsPerSample = 0;
+    numChannels = 0;
+    usesFloatingPointData = false;
+    lengthInSamples = 0;
+
+    for (auto& source : sources)
+    {
+        jassert (source->sampleRate == sampleRate);
+        bitsPerSample = std::max (bitsPerSample, source->bitsPerSample);
+        numChannels = std::max (numChannels, source->numChannels);
+        usesFloatingPointData = usesFloatingPointData || source->usesFloatingPointData;
+    }
+
+    // Mixed integer and float sources are all read as float so samples can be handed on unchanged.
+    if (usesFloatingPointData)
+        bitsPerSample = 32;
+
+    ranges.reserve (rangesToPlay.size());
+    rangeStarts.reserve (rangesToPlay.size());
+
+    for (auto r : rangesToPlay)
+    {
+        if (r.sourceIndex >= (int) sources.size())
+            continue;
+
+        if (r.sourceIndex < 0)
+        {
+            r.sourceIndex = silenceIndex;
+        }
+        else
+        {
+            const auto sourceLength = sources[(size_t) r.sourceIndex]->lengthInSamples;
+            r.sourceStart = juce::jlimit ((juce::int64) 0, sourceLength, r.sourceStart);
+            r.length = std::min (r.length, sourceLength - r.sourceStart);
+        }
+
+        if (r.length <= 0)
+            continue;
+
+        rangeStarts.push_back (lengthInSamples);
+        ranges.push_back (r);
+        lengthInSamples += r.length;
+    }
+}
+
+size_t EditListAudioFormatReader::findRangeIndex (juce::int64 position)
+{
+    // Reads are almost always sequential, so check the cached range and its neighbour
+    // before falling back to a binary search over the range starts.
+    for (auto i = cursor; i < std::min (cursor + 2, ranges.size()); ++i)
+        if (position >= rangeStarts[i] && position < rangeStarts[i] + ranges[i].length)
+            return cursor = i;
+
+    auto it = std::upper_bound (rangeStarts.begin(), rangeStarts.end(), position);
+    cursor = (size_t) std::distance (rangeStarts.begin(), it) - 1;
+    return cursor;
+}
+
+bool EditListAudioFormatReader::readSamples (int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                                             juce::int64 startSampleInFile, int numSamples)
+{
+    if (startSampleInFile < 0)
+    {
+        const auto silence = (int) std::min<juce::int64> (numSamples, -startSampleInFile);
+        clearDest (destChannels, numDestChannels, startOffsetInDestBuffer, silence);
+        startOffsetInDestBuffer += silence;
+        startSampleInFile += silence;
+        numSamples -= silence;
+    }
+
+    while (numSamples > 0)
+    {
+        if (startSampleInFile >= lengthInSamples)
+        {
+            clearDest (destChannels, numDestChannels, startOffsetInDestBuffer, numSamples);
+            break;
+        }
+
+        const auto index = findRangeIndex (startSampleInFile);
+        const auto& range = ranges[index];
+        const auto offsetInRange = startSampleInFile - rangeStarts[index];
+        const auto numThisTime = (int) std::min<juce::int64> (numSamples, range.length - offsetInRange);
+
+        if (range.sourceIndex == silenceIndex)
+        {
+            clearDest (destChannels, numDestChannels, startOffsetInDestBuffer, numThisTime);
+            startOffsetInDestBuffer += numThisTime;
+            startSampleInFile += numThisTime;
+            numSamples -= numThisTime;
+            continue;
+        }
+
+        auto& source = *sources[(size_t) range.sourceIndex];
+
+        if (! source.readSamples (destChannels, numDestChannels, startOffsetInDestBuffer,
+                                  range.sourceStart + offsetInRange, numThisTime))
+            return false;
+
+        // An integer source in a float stream is converted in place.
+        if (usesFloatingPointData && ! source.usesFloatingPointData)
+            for (int ch = 0; ch < numDestChannels; ++ch)
+                if (auto* dest = destChannels[ch])
+                    juce::FloatVectorOperations::convertFixedToFloat (reinterpret_cast<float*> (dest + startOffsetInDestBuffer),
+                                                                      dest + startOffsetInDestBuffer,
+                                                                      1.0f / (float) 0x7fffffff, numThisTime);
+
+        startOffsetInDestBuffer += numThisTime;
+        startSampleInFile += numThisTime;
+        numSamples -= numThisTime;
+    }
+
+    return true;
+}
+
+EditListAudioFormat::EditListAudioFormat (juce::AudioFormatManager& formats)
+    : juce::AudioFormat ("Edit List", fileExtension),
+      sourceFormats (formats)
+{
+}
+
+juce::String EditListAudioFormat::createDescription (const juce::Array<juce::File>& sources, const std::vector<EditListAudioFormatReader::Range>& ranges)
+{
+    juce::String text;
+    text << descriptionHeader << "\n";
+
+    for (auto& source : sources)
+        text << "source " << source.getFullPathName() << "\n"
+             << "source-size " << source.getSize() << "\n"
+             << "source-modified " << source.getLastModificationTime().toMilliseconds() << "\n";
+
+    for (auto& r : ranges)
+        text << "range " << r.sourceIndex << " " << r.sourceStart << " " << r.length << "\n";
+
+    return text;
+}
+
+juce::AudioFormatReader* EditListAudioFormat::createReaderFor (juce::InputStream* sourceStream, bool deleteStreamIfOpeningFails)
+{
+    std::unique_ptr<juce::InputStream> stream (sourceStream);
+
+    // The format manager offers every file to every format, so anything that doesn't start
+    // with the magic is turned away before more of it is read.
+    char magic[4] = {};
+    const bool hasMagic = stream->read (magic, (int) sizeof (magic)) == (int) sizeof (magic)
+                           && std::memcmp (magic, "TEDL", sizeof (magic)) == 0;
+    const auto header = hasMagic ? ("TEDL" + stream->readNextLine()).trim() : juce::String();
+
+    if (header != descriptionHeader && header != singleSourceHeader)
+    {
+        if (! deleteStreamIfOpeningFails)
+            stream.release();
+
+        return nullptr;
+    }
+
+    juce::Array<juce::File> sourceFiles;
+    std::vector<EditListAudioFormatReader::Range> ranges;
+
+    for (auto& line : juce::StringArray::fromLines (stream->readEntireStreamAsString()))
+    {
+        if (line.startsWith ("source "))
+        {
+            sourceFiles.add (juce::File (line.fromFirstOccurrenceOf ("source ", false, false)));
+        }
+        else if (line.startsWith ("range "))
+        {
+            // Version 1 ranges have no source index and always refer to the only source.
+            auto tokens = juce::StringArray::fromTokens (line, " ", {});
+            if (tokens.size() == 3)
+                ranges.push_back ({ tokens[1].getLargeIntValue(), tokens[2].getLargeIntValue(), 0 });
+            else if (tokens.size() == 4)
+                ranges.push_back ({ tokens[2].getLargeIntValue(), tokens[3].getLargeIntValue(), tokens[1].getIntValue() });
+        }
+    }
+
+    std::vector<std::unique_ptr<juce::AudioFormatReader>> sourceReaders;
+
+    for (auto& sourceFile : sourceFiles)
+    {
+        std::unique_ptr<juce::AudioFormatReader> sourceReader;
+
+        // Uncompressed sources (including decoded proxies) are mapped into memory where the
+        // format allows it, so the reads at every range boundary don't go through a stream.
+        if (auto* format = sourceFormats.findFormatForFileExtension (sourceFile.getFileExtension()))
+        {
+            std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (sourceFile));
+
+            if (mapped != nullptr && mapped->mapEntireFile())
+                sourceReader = std::move (mapped);
+        }
+
+        if (sourceReader == nullptr && sourceFile.existsAsFile())
+            sourceReader.reset (sourceFormats.createReaderFor (sourceFile));
+
+        if (sourceReader == nullptr || (! sourceReaders.empty() && sourceReader->sampleRate != sourceReaders.front()->sampleRate))
+        {
+            sourceReaders.clear();
+            break;
+        }
+
+        sourceReaders.push_back (std::move (sourceReader));
+    }
+
+    if (sourceReaders.empty())
+    {
+        if (! deleteStreamIfOpeningFails)
+            stream.release();
+
+        return nullptr;
+    }
+
+    return new EditListAudioFormatReader (std::move (sourceReaders), ranges);
+}
@@ -0,0 +1,69 @@
+/*
+    Virtual "edit list" audio source.
+
+    A .tedl file is a small text description of an ordered list of ranges taken from
+    one or more source files. The reader presents that list as one continuous stream,
+    so the whole segment list can be played as a single clip regardless of how many
+    edits (or recorded takes) it contains. All sources must share a sample rate.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+class EditListAudioFormatReader : public juce::AudioFormatReader
+{
+public:
+    /** A range with sourceIndex == silenceIndex plays silence for its length. */
+    static constexpr int silenceIndex = -1;
+
+    struct Range
+    {
+        juce::int64 sourceStart = 0;
+        juce::int64 length = 0;
+        int sourceIndex = 0;
+    };
+
+    EditListAudioFormatReader (std::vector<std::unique_ptr<juce::AudioFormatReader>> sourceReaders,
+                               const std::vector<Range>& rangesToPlay);
+
+    bool readSamples (int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                      juce::int64 startSampleInFile, int numSamples) override;
+
+private:
+    size_t findRangeIndex (juce::int64 position);
+
+    std::vector<std::unique_ptr<juce::AudioFormatReader>> sources;
+    std::vector<Range> ranges;
+    std::vector<juce::int64> rangeStarts;
+    size_t cursor = 0;
+};
+
+class EditListAudioFormat : public juce::AudioFormat
+{
+public:
+    /** Source files named in an edit list are opened through sourceFormats. */
+    explicit EditListAudioFormat (juce::AudioFormatManager& sourceFormats);
+
+    static constexpr const char* fileExtension = ".tedl";
+
+    /** Builds the text stored in a .tedl file. Each range's sourceIndex refers to the sources
+        array. The size and modification time of every source are included so that the
+        description changes whenever a source does.
+    */
+    static juce::String createDescription (const juce::Array<juce::File>& sources, const std::vector<EditListAudioFormatReader::Range>&);
+
+    juce::Array<int> getPossibleSampleRates() override    { return {}; }
+    juce::Array<int> getPossibleBitDepths() override      { return {}; }
+    bool canDoStereo() override                           { return true; }
+    bool canDoMono() override                             { return true; }
+
+    juce::AudioFormatReader* createReaderFor (juce::InputStream* sourceStream, bool deleteStreamIfOpeningFails) override;
+    juce::AudioFormatWriter* createWriterFor (juce::OutputStream*, double, unsigned int, int,
+                                              const juce::StringPairArray&, int) override    { return nullptr; }
+
+private:
+    juce::AudioFormatManager& sourceFormats;
+};
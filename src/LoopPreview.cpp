@@ -0,0 +1,232 @@
+#include "LoopPreview.h"
+
+LoopPreview::LoopPreview (RenderCache& cacheToUse, juce::AudioFormatManager& formats)
+    : juce::Thread ("Loop preview render"),
+      cache (cacheToUse),
+      formatManager (formats)
+{
+}
+
+LoopPreview::~LoopPreview()
+{
+    stop();
+}
+
+bool LoopPreview::start (te::Edit& editToPlay, te::TimeRange range, std::function<void (bool)> onChange)
+{
+    stop();
+
+    if (range.isEmpty() || range.getLength().inSeconds() > maxLoopSeconds)
+        return false;
+
+    edit = &editToPlay;
+    loopRange = range;
+    onStateChanged = std::move (onChange);
+    active = true;
+
+    renderIfNeeded();
+    startTimer (500);
+    return true;
+}
+
+void LoopPreview::stop()
+{
+    stopTimer();
+    active = false;
+    stopThread (5000);
+
+    if (renderTask != nullptr)
+    {
+        renderTask.reset();
+        renderFile.deleteFile();
+    }
+
+    {
+        const juce::SpinLock::ScopedLockType sl (bufferLock);
+        buffer.setSize (0, 0);
+        playPosition = 0;
+    }
+
+    publishedPosition = 0;
+    playingKey = {};
+    renderingKey = {};
+    edit = nullptr;
+}
+
+double LoopPreview::getPositionSeconds() const noexcept
+{
+    return publishedPosition.load() / deviceSampleRate.load();
+}
+
+juce::String LoopPreview::createKey() const
+{
+    juce::String description;
+    description << "loop-preview|" << loopRange.getStart().inSeconds() << "|" << loopRange.getEnd().inSeconds()
+                << "|" << deviceSampleRate.load() << "\n";
+
+    for (auto* track : te::getAudioTracks (*edit))
+        description << RenderCache::describeState (track->state);
+
+    description << RenderCache::describeState (edit->state.getChildWithName (te::IDs::MASTERPLUGINS));
+    return RenderCache::createKey (description);
+}
+
+void LoopPreview::renderIfNeeded()
+{
+    if (edit == nullptr || ! active.load())
+        return;
+
+    const auto key = createKey();
+    if (key == playingKey || key == renderingKey)
+        return;
+
+    if (auto cached = cache.find (key, ".wav"); cached.existsAsFile() && loadRender (cached))
+    {
+        playingKey = key;
+
+        if (onStateChanged != nullptr)
+            onStateChanged (true);
+
+        return;
+    }
+
+    // One render at a time; the state is checked again when the current one finishes.
+    if (isThreadRunning())
+        return;
+
+    te::Renderer::Parameters params (*edit);
+    params.destFile = cache.getFileForKey (key, ".part");
+    params.audioFormat = &wavFormat;
+    params.tracksToDo = te::toBitSet (te::getAllTracks (*edit));
+    params.time = loopRange;
+    params.sampleRateForAudio = deviceSampleRate.load();
+    params.blockSizeForAudio = edit->engine.getDeviceManager().getBlockSize();
+    params.bitDepth = 32;
+    params.ditheringEnabled = false;
+
+    cache.getDirectory().createDirectory();
+    renderFile = params.destFile;
+    renderFile.deleteFile();
+    renderProgress = 0.0f;
+
+    // The task builds its graph here on the message thread; only the processing runs in the background.
+    renderTask = std::make_unique<te::Renderer::RenderTask> ("Loop preview", params, &renderProgress, nullptr);
+    renderingKey = key;
+    startThread();
+}
+
+bool LoopPreview::loadRender (const juce::File& file)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->lengthInSamples > (juce::int64) (maxLoopSeconds * reader->sampleRate))
+        return false;
+
+    juce::AudioBuffer<float> newBuffer ((int) reader->numChannels, (int) reader->lengthInSamples);
+    reader->read (&newBuffer, 0, newBuffer.getNumSamples(), 0, true, true);
+
+    // Short fades at both ends so the jump from the end of the loop back to its start doesn't click.
+    const auto fade = std::min (edgeFadeSamples, newBuffer.getNumSamples() / 2);
+    newBuffer.applyGainRamp (0, fade, 0.0f, 1.0f);
+    newBuffer.applyGainRamp (newBuffer.getNumSamples() - fade, fade, 1.0f, 0.0f);
+
+    const juce::SpinLock::ScopedLockType sl (bufferLock);
+    std::swap (buffer, newBuffer);
+    playPosition = playPosition % buffer.getNumSamples();
+    return true;
+}
+
+void LoopPreview::run()
+{
+    while (! threadShouldExit())
+        if (renderTask->runJob() != juce::ThreadPoolJob::jobNeedsRunningAgain)
+            break;
+
+    if (threadShouldExit())
+        return;
+
+    juce::MessageManager::callAsync ([weakThis = juce::WeakReference<LoopPreview> (this)]
+    {
+        if (weakThis == nullptr || weakThis->renderTask == nullptr)
+            return;
+
+        auto& self = *weakThis;
+        self.renderTask.reset();
+
+        const auto key = std::exchange (self.renderingKey, juce::String());
+        auto cachedFile = self.cache.getFileForKey (key, ".wav");
+        bool ready = self.renderFile.getSize() > 0 && self.renderFile.moveFileTo (cachedFile);
+
+        if (ready)
+        {
+            self.cache.commit (cachedFile);
+
+            if (self.active.load() && self.loadRender (cachedFile))
+                self.playingKey = key;
+            else
+                ready = false;
+        }
+        else
+        {
+            self.renderFile.deleteFile();
+        }
+
+        if (self.onStateChanged != nullptr)
+            self.onStateChanged (ready);
+
+        // Effects may have been changed while this render was running.
+        self.renderIfNeeded();
+    });
+}
+
+void LoopPreview::timerCallback()
+{
+    renderIfNeeded();
+}
+
+void LoopPreview::audioDeviceIOCallbackWithContext (const float* const*, int,
+                                                    float* const* outputChannelData, int numOutputChannels,
+                                                    int numSamples, const juce::AudioIODeviceCallbackContext&)
+{
+    for (int ch = 0; ch < numOutputChannels; ++ch)
+        if (outputChannelData[ch] != nullptr)
+            juce::FloatVectorOperations::clear (outputChannelData[ch], numSamples);
+
+    if (! active.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType sl (bufferLock);
+    if (! sl.isLocked() || buffer.getNumSamples() == 0)
+        return;
+
+    const auto length = buffer.getNumSamples();
+
+    for (int ch = 0; ch < numOutputChannels; ++ch)
+    {
+        auto* out = outputChannelData[ch];
+        if (out == nullptr)
+            continue;
+
+        const auto* src = buffer.getReadPointer (ch % buffer.getNumChannels());
+
+        for (int done = 0, pos = playPosition; done < numSamples;)
+        {
+            const auto numThisTime = std::min (numSamples - done, length - pos);
+            juce::FloatVectorOperations::copy (out + done, src + pos, numThisTime);
+            done += numThisTime;
+            pos = (pos + numThisTime) % length;
+        }
+    }
+
+    playPosition = (playPosition + numSamples) % length;
+    publishedPosition = playPosition;
+}
+
+void LoopPreview::audioDeviceAboutToStart (juce::AudioIODevice* device)
+{
+    if (device != nullptr)
+        deviceSampleRate = device->getCurrentSampleRate();
+}
+
+void LoopPreview::audioDeviceStopped()
+{
+}
@@ -0,0 +1,83 @@
+/*
+    Selection looping from a pre-rendered buffer.
+
+    The looped range is rendered once through the tracks' and master effects into the
+    render cache, on a background thread, and the device callback then just loops that
+    buffer. The cache key covers the range and the effect state, so a render is only redone
+    when one of them changes; a timer notices such changes while the loop is playing.
+    Ranges longer than maxLoopSeconds aren't held in memory; AudioEngine loops those
+    through the transport instead.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <tracktion_engine/tracktion_engine.h>
+#include "RenderCache.h"
+#include <atomic>
+#include <functional>
+
+namespace te = tracktion;
+
+class LoopPreview : public juce::AudioIODeviceCallback,
+                    private juce::Thread,
+                    private juce::Timer
+{
+public:
+    LoopPreview (RenderCache& cacheToUse, juce::AudioFormatManager& formats);
+    ~LoopPreview() override;
+
+    /** Longest range that's looped from memory; start() refuses anything longer. */
+    static constexpr double maxLoopSeconds = 300.0;
+
+    /** Starts looping range. Playback begins as soon as a render for the current state is
+        available, straight away if one is cached. onStateChanged is called on the message
+        thread whenever a render finishes or fails. Call from the message thread.
+    */
+    bool start (te::Edit& editToPlay, te::TimeRange range, std::function<void (bool renderReady)> onStateChanged = {});
+    void stop();
+
+    bool isActive() const noexcept                      { return active.load(); }
+    bool isRendering() const                            { return isThreadRunning(); }
+
+    /** Position within the looped range, in seconds. */
+    double getPositionSeconds() const noexcept;
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                           float* const* outputChannelData, int numOutputChannels,
+                                           int numSamples, const juce::AudioIODeviceCallbackContext&) override;
+    void audioDeviceAboutToStart (juce::AudioIODevice*) override;
+    void audioDeviceStopped() override;
+
+private:
+    static constexpr int edgeFadeSamples = 128;
+
+    juce::String createKey() const;
+    void renderIfNeeded();
+    bool loadRender (const juce::File&);
+    void run() override;
+    void timerCallback() override;
+
+    RenderCache& cache;
+    juce::AudioFormatManager& formatManager;
+    te::Edit* edit = nullptr;
+    te::TimeRange loopRange;
+    std::function<void (bool)> onStateChanged;
+
+    juce::WavAudioFormat wavFormat;
+    juce::String playingKey, renderingKey;
+    std::unique_ptr<te::Renderer::RenderTask> renderTask;
+    juce::File renderFile;
+    std::atomic<float> renderProgress { 0.0f };
+
+    juce::SpinLock bufferLock;
+    juce::AudioBuffer<float> buffer;
+    int playPosition = 0;
+
+    std::atomic<bool> active { false };
+    std::atomic<int> publishedPosition { 0 };
+    std::atomic<double> deviceSampleRate { 44100.0 };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (LoopPreview)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoopPreview)
+};
@@ -1,7 +1,13 @@
 #include "MainController.h"
 #include "AudioEngine.h"
 #include "AudioExporter.h"
+#include "ControlServer.h"
 #include "NonDestructiveEditorComponent.h"
+#include "PluginScanner.h"
+#include "RenderRegression.h"
+#include "SampleRateConverter.h"
+#include "Wave64AudioFormat.h"
+#include <iostream>
 
 class NonDestructiveEditorApplication::MainWindow : public juce::DocumentWindow
 {
@@ -26,6 +32,14 @@ public:
         JUCEApplication::getInstance()->systemRequestedQuit();
     }
 
+    void paintOverChildren (juce::Graphics&) override
+    {
+        if (onFirstPaint != nullptr)
+            std::exchange (onFirstPaint, nullptr)();
+    }
+
+    std::function<void()> onFirstPaint;
+
 private:
     AudioEngine& audioEngine;
     AudioExporter& audioExporter;
@@ -46,16 +60,142 @@ bool NonDestructiveEditorApplication::moreThanOneInstanceAllowed()
     return true;
 }
 
-void NonDestructiveEditorApplication::initialise (const juce::String&)
+void NonDestructiveEditorApplication::initialise (const juce::String& commandLine)
 {
+    if (PluginScanner::performChildScanIfRequested (commandLine))
+    {
+        quit();
+        return;
+    }
+
+    if (commandLine.contains ("--benchmark-src"))
+    {
+        std::cout << SampleRateConverter::runBenchmark() << std::flush;
+        quit();
+        return;
+    }
+
+    // Like --render-regression, headless and without a render cache, so no hardware is opened
+    // and every export is timed as a real render.
+    if (commandLine.contains ("--benchmark-rpc"))
+    {
+        AudioEngine engine (false);
+        AudioExporter exporter;
+        std::cout << ControlServer::runBenchmark (engine, exporter) << std::flush;
+        quit();
+        return;
+    }
+
+    // --check-w64-streaming[=folder] writes and reads back a W64 file over 4 GB, checking memory stays bounded.
+    if (auto folderArg = commandLine.fromFirstOccurrenceOf ("--check-w64-streaming", false, false); commandLine.contains ("--check-w64-streaming"))
+    {
+        auto folderPath = folderArg.startsWithChar ('=') ? folderArg.substring (1).upToFirstOccurrenceOf (" ", false, false).unquoted()
+                                                         : juce::String();
+        auto folder = folderPath.isNotEmpty() ? juce::File::getCurrentWorkingDirectory().getChildFile (folderPath)
+                                              : juce::File::getSpecialLocation (juce::File::tempDirectory);
+
+        juce::String report;
+        const bool passed = Wave64AudioFormat::runStreamingCheck (folder, report);
+        std::cout << report << std::flush;
+        setApplicationReturnValue (passed ? 0 : 1);
+        quit();
+        return;
+    }
+
+    // --render-regression[=manifest] checks exports against goldens; add --update-goldens to record them.
+    // The engine never opens a device, and the exporter has no render cache, so every render is real and timed.
+    if (auto manifestArg = commandLine.fromFirstOccurrenceOf ("--render-regression", false, false); commandLine.contains ("--render-regression"))
+    {
+        RenderRegression::Options options;
+        auto manifestPath = manifestArg.startsWithChar ('=') ? manifestArg.substring (1).upToFirstOccurrenceOf (" ", false, false).unquoted()
+                                                             : juce::String();
+        options.manifest = manifestPath.isNotEmpty() ? juce::File::getCurrentWorkingDirectory().getChildFile (manifestPath)
+                                                     : juce::File::getCurrentWorkingDirectory().getChildFile ("RenderRegression/goldens.json");
+        options.updateGoldens = commandLine.contains ("--update-goldens");
+
+        AudioEngine engine (false);
+        AudioExporter exporter;
+        juce::String report;
+        const bool passed = RenderRegression::run (engine, exporter, options, report);
+        std::cout << report << std::flush;
+        setApplicationReturnValue (passed ? 0 : 1);
+        quit();
+        return;
+    }
+
+    startupStartMs = juce::Time::getMillisecondCounterHiRes();
+
     audioEngine = std::make_unique<AudioEngine>();
-    audioExporter = std::make_unique<AudioExporter>();
+    markStartupPhase ("engine");
+    audioExporter = std::make_unique<AudioExporter> (&audioEngine->getRenderCache());
     mainWindow.reset (new MainWindow ("Non-Destructive Editor", *audioEngine, *audioExporter));
+    markStartupPhase ("window created");
+
+    // --control-socket[=path] lets scripts drive the editor; see ControlServer.h for the protocol.
+    if (auto socketArg = commandLine.fromFirstOccurrenceOf ("--control-socket", false, false); commandLine.contains ("--control-socket"))
+    {
+        auto socketPath = socketArg.startsWithChar ('=') ? socketArg.substring (1).upToFirstOccurrenceOf (" ", false, false).unquoted()
+                                                         : juce::String();
+        auto socketFile = socketPath.isNotEmpty() ? juce::File (socketPath) : ControlServer::getDefaultSocketFile();
+
+        juce::String status ("No private folder for the socket");
+        controlServer = std::make_unique<ControlServer> (*audioEngine, *audioExporter);
+
+        if (socketFile != juce::File())
+            controlServer->start (socketFile, status);
+        DBG ("Control socket: " << status);
+    }
+
+    mainWindow->onFirstPaint = [this]
+    {
+        markStartupPhase ("first paint");
+
+        // Open the device once the window is on screen rather than before it appears.
+        juce::MessageManager::callAsync ([this]
+        {
+            if (audioEngine == nullptr)
+                return;
+
+            audioEngine->initialiseAudioDevice();
+            markStartupPhase ("audio device");
+            logStartupReport();
+
+            audioEngine->startPluginScan();
+        });
+    };
+}
+
+void NonDestructiveEditorApplication::markStartupPhase (const juce::String& name)
+{
+    startupPhases.push_back ({ name, juce::Time::getMillisecondCounterHiRes() - startupStartMs });
+}
+
+void NonDestructiveEditorApplication::logStartupReport() const
+{
+    constexpr double firstPaintTargetMs = 300.0;
+
+    juce::String report ("Startup timings:");
+    double previousMs = 0.0;
+
+    for (auto& phase : startupPhases)
+    {
+        report << "\n  " << phase.name.paddedRight (' ', 16)
+               << juce::String (phase.elapsedMs, 1) << " ms (+" << juce::String (phase.elapsedMs - previousMs, 1) << " ms)";
+        previousMs = phase.elapsedMs;
+
+        if (phase.name == "first paint" && phase.elapsedMs > firstPaintTargetMs)
+            report << "  <-- over " << firstPaintTargetMs << " ms target";
+    }
+
+    // The performance log rather than DBG, so release builds (where the numbers matter) record it too.
+    if (audioEngine != nullptr)
+        audioEngine->logPerformanceEvent (report);
 }
 
 void NonDestructiveEditorApplication::shutdown()
 {
     mainWindow = nullptr;
+    controlServer.reset();
     audioExporter.reset();
     audioEngine.reset();
 }
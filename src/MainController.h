@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <vector>
 
 class NonDestructiveEditorApplication : public juce::JUCEApplication
 {
@@ -15,8 +16,20 @@ public:
     void systemRequestedQuit() override;
 
 private:
+    struct StartupPhase
+    {
+        juce::String name;
+        double elapsedMs = 0.0;
+    };
+
+    void markStartupPhase (const juce::String& name);
+    void logStartupReport() const;
+
     class MainWindow;
     std::unique_ptr<MainWindow> mainWindow;
     std::unique_ptr<class AudioEngine> audioEngine;
     std::unique_ptr<class AudioExporter> audioExporter;
+    std::unique_ptr<class ControlServer> controlServer;
+    double startupStartMs = 0.0;
+    std::vector<StartupPhase> startupPhases;
 };
@@ -0,0 +1,159 @@
+#include "PerformanceMonitor.h"
+
+namespace
+{
+    template <typename Type>
+    void storeMax (std::atomic<Type>& target, Type value) noexcept
+    {
+        auto current = target.load();
+        while (value > current && ! target.compare_exchange_weak (current, value)) {}
+    }
+}
+
+PerformanceMonitor::PerformanceMonitor (juce::AudioDeviceManager& manager, const juce::File& logFile)
+    : deviceManager (manager)
+{
+    logFile.getParentDirectory().createDirectory();
+    logger = std::make_unique<juce::FileLogger> (logFile, "Audio performance log", 1024 * 1024);
+
+    startTimer (1000);
+}
+
+PerformanceMonitor::~PerformanceMonitor()
+{
+    stopTimer();
+
+    // Hands the engine's callback back to the device manager, which the engine expects to find it in.
+    if (auto* engineCallback = std::exchange (timedCallback.engineCallback, nullptr))
+    {
+        deviceManager.removeAudioCallback (&timedCallback);
+        deviceManager.addAudioCallback (engineCallback);
+    }
+}
+
+void PerformanceMonitor::timeEngineCallback (juce::AudioIODeviceCallback& engineCallback)
+{
+    if (timedCallback.engineCallback != nullptr)
+        return;
+
+    // Removing stops the engine's callback and adding the wrapper prepares it again, so it
+    // is never called both directly and through the wrapper.
+    deviceManager.removeAudioCallback (&engineCallback);
+    timedCallback.engineCallback = &engineCallback;
+    deviceManager.addAudioCallback (&timedCallback);
+}
+
+void PerformanceMonitor::noteGraphRebuild (const juce::String& reason)
+{
+    ++graphRebuilds;
+    logEvent ("Graph rebuild: " + reason);
+}
+
+void PerformanceMonitor::TimedCallback::audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                                                          float* const* outputChannelData, int numOutputChannels,
+                                                                          int numSamples, const juce::AudioIODeviceCallbackContext& context)
+{
+    const auto start = juce::Time::getHighResolutionTicks();
+    engineCallback->audioDeviceIOCallbackWithContext (inputChannelData, numInputChannels, outputChannelData, numOutputChannels,
+                                                      numSamples, context);
+    const auto end = juce::Time::getHighResolutionTicks();
+    const auto rate = owner.sampleRate.load();
+
+    if (rate > 0.0 && numSamples > 0)
+    {
+        const auto blockSeconds = numSamples / rate;
+        const auto load = juce::Time::highResolutionTicksToSeconds (end - start) / blockSeconds;
+
+        owner.loadSum.fetch_add (load);
+        ++owner.numLoadSamples;
+        storeMax (owner.loadPeak, (float) load);
+        ++owner.loadHistogram[(size_t) juce::jlimit (0, numLoadBuckets - 1, (int) (load * 10.0))];
+
+        if (owner.previousCallbackTicks != 0)
+        {
+            const auto intervalSeconds = juce::Time::highResolutionTicksToSeconds (start - owner.previousCallbackTicks);
+            storeMax (owner.maxJitterMs, (float) (1000.0 * std::abs (intervalSeconds - blockSeconds)));
+        }
+    }
+
+    owner.previousCallbackTicks = start;
+    ++owner.callbacks;
+}
+
+void PerformanceMonitor::TimedCallback::audioDeviceAboutToStart (juce::AudioIODevice* device)
+{
+    if (device != nullptr)
+    {
+        owner.sampleRate = device->getCurrentSampleRate();
+        owner.blockSize = device->getCurrentBufferSizeSamples();
+    }
+
+    owner.previousCallbackTicks = 0;
+    engineCallback->audioDeviceAboutToStart (device);
+}
+
+void PerformanceMonitor::TimedCallback::audioDeviceStopped()
+{
+    engineCallback->audioDeviceStopped();
+}
+
+void PerformanceMonitor::TimedCallback::audioDeviceError (const juce::String& message)
+{
+    engineCallback->audioDeviceError (message);
+}
+
+void PerformanceMonitor::timerCallback()
+{
+    updateSnapshot();
+}
+
+void PerformanceMonitor::updateSnapshot()
+{
+    const auto numBlocks = numLoadSamples.exchange (0);
+    const auto totalLoad = loadSum.exchange (0.0);
+
+    snapshot.sampleRate = sampleRate.load();
+    snapshot.blockSize = blockSize.load();
+    snapshot.averageLoad = numBlocks > 0 ? totalLoad / (double) numBlocks : 0.0;
+    snapshot.peakLoad = loadPeak.exchange (0.0f);
+    snapshot.maxJitterMs = maxJitterMs.exchange (0.0f);
+    snapshot.callbacks = callbacks.load();
+    snapshot.xruns = deviceManager.getXRunCount();
+    snapshot.graphRebuilds = graphRebuilds;
+
+    for (size_t i = 0; i < loadHistogram.size(); ++i)
+        snapshot.loadHistogram[i] = loadHistogram[i].load();
+
+    // Xruns are logged as soon as they're seen; everything else every logIntervalSeconds.
+    const bool newXruns = snapshot.xruns > lastLoggedXruns;
+
+    if (newXruns || (++secondsSinceLog >= logIntervalSeconds && numBlocks > 0))
+    {
+        logEvent (describe (snapshot));
+        secondsSinceLog = 0;
+        lastLoggedXruns = snapshot.xruns;
+    }
+}
+
+void PerformanceMonitor::logEvent (const juce::String& message)
+{
+    DBG (message);
+
+    if (logger != nullptr)
+        logger->logMessage (juce::Time::getCurrentTime().toString (false, true, true, true) + "  " + message);
+}
+
+juce::String PerformanceMonitor::describe (const Snapshot& s)
+{
+    juce::String text;
+    text << "Audio load " << juce::roundToInt (s.averageLoad * 100.0) << "% (peak " << juce::roundToInt (s.peakLoad * 100.0) << "%)"
+         << " | jitter " << juce::String (s.maxJitterMs, 2) << " ms"
+         << " | xruns " << s.xruns
+         << " | rebuilds " << s.graphRebuilds
+         << " | " << s.blockSize << " @ " << s.sampleRate << " Hz | load histogram";
+
+    for (auto count : s.loadHistogram)
+        text << " " << (juce::int64) count;
+
+    return text;
+}
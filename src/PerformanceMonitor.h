@@ -0,0 +1,95 @@
+/*
+    Audio-thread load monitor.
+
+    The engine's device callback is wrapped so that every block it renders is timed against
+    the block's duration and counted in a histogram, so a single slow block shows up rather
+    than being smoothed away. The wrapper also measures how regularly the device calls back
+    (jitter), using only atomics on the audio thread; xruns come from the device manager.
+    Once a second the figures become a snapshot for the UI and, periodically or whenever
+    new xruns appear, a log line along with graph rebuild events.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+class PerformanceMonitor : private juce::Timer
+{
+public:
+    /** Load buckets are 10% of the block's time budget wide; the last one counts blocks at or over budget. */
+    static constexpr int numLoadBuckets = 11;
+
+    struct Snapshot
+    {
+        double sampleRate = 0.0;
+        int blockSize = 0;
+        double averageLoad = 0.0, peakLoad = 0.0;   // of the block budget, over the blocks of the last second
+        double maxJitterMs = 0.0;                   // largest deviation of a callback interval from the block length
+        std::array<juce::uint64, numLoadBuckets> loadHistogram {};
+        juce::uint64 callbacks = 0;
+        int xruns = 0;                              // reported by the device, or detected by the load measurer
+        int graphRebuilds = 0;
+    };
+
+    PerformanceMonitor (juce::AudioDeviceManager&, const juce::File& logFile);
+    ~PerformanceMonitor() override;
+
+    /** Takes over calling the engine's device callback so each block it renders can be timed.
+        Call on the message thread once the engine has registered the callback with the device manager.
+    */
+    void timeEngineCallback (juce::AudioIODeviceCallback& engineCallback);
+
+    /** Called on the message thread whenever the playback graph is rebuilt. */
+    void noteGraphRebuild (const juce::String& reason);
+
+    /** Writes a line to the log (and to the debug output). Message thread only. */
+    void logEvent (const juce::String& message);
+
+    const Snapshot& getSnapshot() const noexcept        { return snapshot; }
+    static juce::String describe (const Snapshot&);
+
+private:
+    static constexpr int logIntervalSeconds = 10;
+
+    struct TimedCallback : public juce::AudioIODeviceCallback
+    {
+        explicit TimedCallback (PerformanceMonitor& o) : owner (o) {}
+
+        void audioDeviceIOCallbackWithContext (const float* const*, int, float* const*, int, int,
+                                               const juce::AudioIODeviceCallbackContext&) override;
+        void audioDeviceAboutToStart (juce::AudioIODevice*) override;
+        void audioDeviceStopped() override;
+        void audioDeviceError (const juce::String&) override;
+
+        PerformanceMonitor& owner;
+        juce::AudioIODeviceCallback* engineCallback = nullptr;
+    };
+
+    void timerCallback() override;
+    void updateSnapshot();
+
+    juce::AudioDeviceManager& deviceManager;
+    TimedCallback timedCallback { *this };
+    std::unique_ptr<juce::FileLogger> logger;
+
+    // Written only on the audio thread.
+    juce::int64 previousCallbackTicks = 0;
+
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<int> blockSize { 0 };
+    std::atomic<float> maxJitterMs { 0.0f };
+    std::atomic<juce::uint64> callbacks { 0 };
+
+    // Added to on the audio thread; the sum and peak are taken and reset once a second.
+    std::array<std::atomic<juce::uint64>, numLoadBuckets> loadHistogram {};
+    std::atomic<double> loadSum { 0.0 };
+    std::atomic<float> loadPeak { 0.0f };
+    std::atomic<juce::uint64> numLoadSamples { 0 };
+
+    Snapshot snapshot;
+    int graphRebuilds = 0, secondsSinceLog = 0, lastLoggedXruns = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceMonitor)
+};
@@ -0,0 +1,120 @@
+#include "PlaylistPrefetcher.h"
+
+PlaylistPrefetcher::PlaylistPrefetcher (juce::AudioFormatManager& formats, juce::int64 readAheadLimitBytes)
+    : juce::Thread ("Playlist prefetch"), formatManager (formats), readAheadLimit (readAheadLimitBytes)
+{
+}
+
+PlaylistPrefetcher::~PlaylistPrefetcher()
+{
+    stopThread (5000);
+}
+
+void PlaylistPrefetcher::prefetch (const juce::Array<juce::File>& upcoming)
+{
+    {
+        const juce::ScopedLock sl (lock);
+        std::vector<std::shared_ptr<Entry>> newEntries;
+
+        for (auto& file : upcoming)
+        {
+            auto existing = std::find_if (entries.begin(), entries.end(), [&] (auto& e) { return e->file == file; });
+
+            if (existing != entries.end())
+            {
+                newEntries.push_back (*existing);
+            }
+            else
+            {
+                auto entry = std::make_shared<Entry>();
+                entry->file = file;
+                newEntries.push_back (std::move (entry));
+            }
+        }
+
+        entries = std::move (newEntries);
+    }
+
+    if (isThreadRunning())
+        notify();
+    else
+        startThread (juce::Thread::Priority::low);
+}
+
+void PlaylistPrefetcher::clear()
+{
+    prefetch ({});
+}
+
+void PlaylistPrefetcher::run()
+{
+    while (! threadShouldExit())
+    {
+        std::shared_ptr<Entry> next;
+        juce::int64 budget = readAheadLimit;
+
+        {
+            const juce::ScopedLock sl (lock);
+
+            for (auto& e : entries)
+            {
+                budget -= e->bytesRead;
+
+                if (next == nullptr && ! e->done)
+                    next = e;
+            }
+        }
+
+        if (next == nullptr)
+        {
+            wait (-1);
+            continue;
+        }
+
+        // Read off the lock; an entry dropped from the playlist meanwhile is simply released.
+        const auto numRead = readAhead (next->file, std::min (budget, getBytesToRead (next->file)));
+
+        const juce::ScopedLock sl (lock);
+        next->bytesRead = numRead;
+        next->done = true;
+    }
+}
+
+juce::int64 PlaylistPrefetcher::getBytesToRead (const juce::File& file) const
+{
+    const auto fileSize = file.getSize();
+    auto* format = formatManager.findFormatForFileExtension (file.getFileExtension());
+
+    if (format == nullptr || format->isCompressed())
+        return fileSize;
+
+    std::unique_ptr<juce::FileInputStream> in (file.createInputStream());
+    std::unique_ptr<juce::AudioFormatReader> reader (in != nullptr ? format->createReaderFor (in.release(), true) : nullptr);
+
+    if (reader == nullptr || reader->sampleRate <= 0.0)
+        return std::min (fileSize, headerBytes);
+
+    const auto frameBytes = (juce::int64) reader->numChannels * (juce::int64) (reader->bitsPerSample / 8);
+    return std::min (fileSize, headerBytes + (juce::int64) (headSeconds * reader->sampleRate) * frameBytes);
+}
+
+juce::int64 PlaylistPrefetcher::readAhead (const juce::File& file, juce::int64 numBytes)
+{
+    juce::FileInputStream in (file);
+    juce::int64 numRead = 0;
+
+    if (! in.openedOk())
+        return 0;
+
+    while (numRead < numBytes && ! threadShouldExit())
+    {
+        const auto numThisTime = in.read (chunk.get(), (int) std::min<juce::int64> (chunkBytes, numBytes - numRead));
+
+        if (numThisTime <= 0)
+            break;
+
+        numRead += numThisTime;
+    }
+
+    return numRead;
+}
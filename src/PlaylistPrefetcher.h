@@ -0,0 +1,52 @@
+/*
+    Warms the OS page cache for the next few files of a review playlist.
+
+    Loading opens each file afresh (tracktion creates its own readers), so what prefetching
+    can save is the disk reads. A background thread reads ahead, nearest file first, the
+    header and first few seconds of each uncompressed file, and the whole of each compressed
+    one, which its proxy decode reads end to end anyway. Nothing is kept open or held in this
+    process's memory, and the total read for the files ahead is capped, so long compressed
+    files can't turn a lookahead into reading whole albums.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+class PlaylistPrefetcher : private juce::Thread
+{
+public:
+    PlaylistPrefetcher (juce::AudioFormatManager& formats, juce::int64 readAheadLimitBytes);
+    ~PlaylistPrefetcher() override;
+
+    /** Replaces the files to read ahead, nearest first. Files already read are skipped. */
+    void prefetch (const juce::Array<juce::File>& upcoming);
+    void clear();
+
+private:
+    static constexpr double headSeconds = 10.0;
+    static constexpr juce::int64 headerBytes = 64 * 1024;
+    static constexpr int chunkBytes = 1024 * 1024;
+
+    struct Entry
+    {
+        juce::File file;
+        juce::int64 bytesRead = 0;
+        bool done = false;
+    };
+
+    void run() override;
+    juce::int64 getBytesToRead (const juce::File&) const;
+    juce::int64 readAhead (const juce::File&, juce::int64 numBytes);
+
+    juce::AudioFormatManager& formatManager;
+    const juce::int64 readAheadLimit;
+    juce::HeapBlock<char> chunk { (size_t) chunkBytes };     // read thread only
+
+    juce::CriticalSection lock;
+    std::vector<std::shared_ptr<Entry>> entries;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlaylistPrefetcher)
+};
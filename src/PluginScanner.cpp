@@ -0,0 +1,292 @@
+#include "PluginScanner.h"
+
+namespace
+{
+    const juce::String childScanArgument ("--scan-plugin");
+    constexpr int childScanTimeoutMs = 60000;
+
+    const juce::Identifier cacheTag ("PLUGIN_SCAN_CACHE"), binaryTag ("BINARY"), formatAttr ("format"),
+                           identifierAttr ("identifier"), modifiedAttr ("modified"), failedAttr ("failed");
+}
+
+bool PluginScanner::performChildScanIfRequested (const juce::String& commandLine)
+{
+    juce::StringArray args;
+    args.addTokens (commandLine, true);
+
+    const auto index = args.indexOf (childScanArgument);
+    if (index < 0)
+        return false;
+
+    const auto formatName = args[index + 1].unquoted();
+    const auto identifier = args[index + 2].unquoted();
+    const juce::File resultFile (args[index + 3].unquoted());
+
+    juce::AudioPluginFormatManager formats;
+   #if JUCE_PLUGINHOST_VST3
+    formats.addFormat (new juce::VST3PluginFormat());
+   #endif
+   #if JUCE_PLUGINHOST_LADSPA && JUCE_LINUX
+    formats.addFormat (new juce::LADSPAPluginFormat());
+   #endif
+   #if JUCE_PLUGINHOST_AU && (JUCE_MAC || JUCE_IOS)
+    formats.addFormat (new juce::AudioUnitPluginFormat());
+   #endif
+
+    juce::XmlElement results ("PLUGINS");
+
+    for (int i = 0; i < formats.getNumFormats(); ++i)
+    {
+        auto* format = formats.getFormat (i);
+        if (format->getName() != formatName)
+            continue;
+
+        juce::OwnedArray<juce::PluginDescription> found;
+        format->findAllTypesForFile (found, identifier);
+
+        for (auto* desc : found)
+            results.addChildElement (desc->createXml().release());
+    }
+
+    // If loading the plugin crashes or hangs this process, no result file gets written
+    // and the parent records the binary as failed until it changes.
+    results.writeTo (resultFile);
+    return true;
+}
+
+PluginScanner::PluginScanner (juce::AudioPluginFormatManager& formats, juce::KnownPluginList& pluginList, const juce::File& cacheFileToUse)
+    : juce::Thread ("Plugin scanner"),
+      formatManager (formats),
+      knownPlugins (pluginList),
+      cacheFile (cacheFileToUse)
+{
+}
+
+PluginScanner::~PluginScanner()
+{
+    stopThread (childScanTimeoutMs);
+}
+
+void PluginScanner::startScan (std::function<void (int)> onFinished)
+{
+    if (isThreadRunning())
+        return;
+
+    onScanFinished = std::move (onFinished);
+    startThread (juce::Thread::Priority::background);
+}
+
+juce::int64 PluginScanner::getModificationTime (const juce::String& identifier)
+{
+    // Some formats (e.g. AudioUnits) identify plugins by something other than a file path.
+    if (! juce::File::isAbsolutePath (identifier))
+        return 0;
+
+    return juce::File (identifier).getLastModificationTime().toMilliseconds();
+}
+
+void PluginScanner::loadCache()
+{
+    cache.clear();
+
+    auto xml = juce::parseXML (cacheFile);
+    if (xml == nullptr || ! xml->hasTagName (cacheTag))
+        return;
+
+    for (auto* binary : xml->getChildWithTagNameIterator (binaryTag))
+    {
+        auto* entry = cache.add (new CacheEntry());
+        entry->formatName = binary->getStringAttribute (formatAttr);
+        entry->identifier = binary->getStringAttribute (identifierAttr);
+        entry->modificationTime = binary->getStringAttribute (modifiedAttr).getLargeIntValue();
+        entry->failed = binary->getBoolAttribute (failedAttr);
+
+        for (auto* e : binary->getChildIterator())
+        {
+            juce::PluginDescription desc;
+            if (desc.loadFromXml (*e))
+                entry->types.add (new juce::PluginDescription (desc));
+        }
+    }
+}
+
+void PluginScanner::saveCache() const
+{
+    juce::XmlElement xml (cacheTag);
+
+    for (auto* entry : cache)
+    {
+        auto* binary = xml.createNewChildElement (binaryTag);
+        binary->setAttribute (formatAttr, entry->formatName);
+        binary->setAttribute (identifierAttr, entry->identifier);
+        binary->setAttribute (modifiedAttr, juce::String (entry->modificationTime));
+        binary->setAttribute (failedAttr, entry->failed ? 1 : 0);
+
+        for (auto* desc : entry->types)
+            binary->addChildElement (desc->createXml().release());
+    }
+
+    cacheFile.getParentDirectory().createDirectory();
+    xml.writeTo (cacheFile);
+}
+
+bool PluginScanner::scanInChildProcess (juce::AudioPluginFormat& format, CacheEntry& entry)
+{
+    auto resultFile = juce::File::createTempFile (".xml");
+    const juce::StringArray args { juce::File::getSpecialLocation (juce::File::currentExecutableFile).getFullPathName(),
+                                   childScanArgument, format.getName(), entry.identifier,
+                                   resultFile.getFullPathName() };
+
+    juce::ChildProcess child;
+
+    {
+        // Started under the lock, so a stop either sees this child or stops it from starting.
+        const juce::ScopedLock sl (childLock);
+
+        if (threadShouldExit() || ! child.start (args, 0))
+            return false;
+
+        runningChildren.add (&child);
+    }
+
+    const bool finished = child.waitForProcessToFinish (childScanTimeoutMs);
+
+    {
+        const juce::ScopedLock sl (childLock);
+        runningChildren.removeFirstMatchingValue (&child);
+    }
+
+    if (! finished)
+    {
+        child.kill();
+        resultFile.deleteFile();
+        return false;
+    }
+
+    auto xml = juce::parseXML (resultFile);
+    resultFile.deleteFile();
+
+    if (child.getExitCode() != 0 || xml == nullptr)
+        return false;
+
+    for (auto* e : xml->getChildIterator())
+    {
+        juce::PluginDescription desc;
+        if (desc.loadFromXml (*e))
+            entry.types.add (new juce::PluginDescription (desc));
+    }
+
+    return true;
+}
+
+void PluginScanner::killRunningChildren()
+{
+    const juce::ScopedLock sl (childLock);
+
+    for (auto* child : runningChildren)
+        child->kill();
+}
+
+void PluginScanner::run()
+{
+    loadCache();
+
+    juce::OwnedArray<CacheEntry> newCache;
+    std::vector<std::pair<juce::AudioPluginFormat*, CacheEntry*>> toScan;
+
+    for (int i = 0; i < formatManager.getNumFormats(); ++i)
+    {
+        auto* format = formatManager.getFormat (i);
+        auto identifiers = format->searchPathsForPlugins (format->getDefaultLocationsToSearch(), true, false);
+
+        for (auto& identifier : identifiers)
+        {
+            auto* entry = newCache.add (new CacheEntry());
+            entry->formatName = format->getName();
+            entry->identifier = identifier;
+            entry->modificationTime = getModificationTime (identifier);
+
+            auto* cached = [&]() -> CacheEntry*
+            {
+                for (auto* c : cache)
+                    if (c->formatName == entry->formatName && c->identifier == identifier)
+                        return c;
+
+                return nullptr;
+            }();
+
+            if (cached != nullptr && cached->modificationTime == entry->modificationTime)
+            {
+                entry->failed = cached->failed;
+                for (auto* desc : cached->types)
+                    entry->types.add (new juce::PluginDescription (*desc));
+            }
+            else
+            {
+                toScan.push_back ({ format, entry });
+            }
+        }
+    }
+
+    {
+        juce::ThreadPool pool (juce::jmax (1, juce::SystemStats::getNumCpus()));
+
+        for (auto& job : toScan)
+        {
+            pool.addJob ([this, job]
+            {
+                if (! threadShouldExit())
+                    job.second->failed = ! scanInChildProcess (*job.first, *job.second);
+            });
+        }
+
+        while (pool.getNumJobs() > 0 && ! threadShouldExit())
+            wait (50);
+
+        // Quitting shouldn't wait on a plugin that's slow to load, so the scans still
+        // running are abandoned and their binaries rescanned next time.
+        if (threadShouldExit())
+            killRunningChildren();
+
+        pool.removeAllJobs (true, childScanTimeoutMs);
+    }
+
+    if (threadShouldExit())
+        return;
+
+    cache.swapWith (newCache);
+    saveCache();
+
+    // The message thread gets its own copy of the results, since a new scan reloads the cache.
+    juce::StringArray failedIdentifiers, scannedIdentifiers;
+    std::vector<juce::PluginDescription> types;
+
+    for (auto* entry : cache)
+    {
+        (entry->failed ? failedIdentifiers : scannedIdentifiers).add (entry->identifier);
+
+        for (auto* desc : entry->types)
+            types.push_back (*desc);
+    }
+
+    const auto numScanned = (int) toScan.size();
+    juce::MessageManager::callAsync ([weakThis = juce::WeakReference<PluginScanner> (this), numScanned,
+                                      failedIdentifiers, scannedIdentifiers, types]
+    {
+        if (weakThis == nullptr)
+            return;
+
+        // A binary that failed before but has changed and now scans cleanly is usable again.
+        for (auto& identifier : scannedIdentifiers)
+            weakThis->knownPlugins.removeFromBlacklist (identifier);
+
+        for (auto& identifier : failedIdentifiers)
+            weakThis->knownPlugins.addToBlacklist (identifier);
+
+        for (auto& desc : types)
+            weakThis->knownPlugins.addType (desc);
+
+        if (weakThis->onScanFinished != nullptr)
+            weakThis->onScanFinished (numScanned);
+    });
+}
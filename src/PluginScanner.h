@@ -0,0 +1,59 @@
+/*
+    Out-of-process plugin scanning with a persistent cache.
+
+    Each plugin binary is scanned by a child copy of this executable, so a plugin that
+    crashes or hangs while being loaded only takes down that child. Results are cached
+    by plugin path and modification time, so a rescan only launches children for
+    binaries that were added or changed, several at a time.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+
+class PluginScanner : private juce::Thread
+{
+public:
+    /** Call at the very start of JUCEApplication::initialise(). Returns true if this process
+        was launched as a scan child, in which case it has done its work and should quit.
+    */
+    static bool performChildScanIfRequested (const juce::String& commandLine);
+
+    PluginScanner (juce::AudioPluginFormatManager& formats, juce::KnownPluginList& pluginList, const juce::File& cacheFile);
+    ~PluginScanner() override;
+
+    /** Starts a background rescan. onFinished is called on the message thread with the
+        number of binaries that had to be scanned.
+    */
+    void startScan (std::function<void (int numScanned)> onFinished);
+    bool isScanning() const      { return isThreadRunning(); }
+
+private:
+    struct CacheEntry
+    {
+        juce::String formatName, identifier;
+        juce::int64 modificationTime = 0;
+        bool failed = false;
+        juce::OwnedArray<juce::PluginDescription> types;
+    };
+
+    void run() override;
+    void loadCache();
+    void saveCache() const;
+    bool scanInChildProcess (juce::AudioPluginFormat&, CacheEntry&);
+    void killRunningChildren();
+    static juce::int64 getModificationTime (const juce::String& identifier);
+
+    juce::AudioPluginFormatManager& formatManager;
+    juce::KnownPluginList& knownPlugins;
+    const juce::File cacheFile;
+    juce::OwnedArray<CacheEntry> cache;
+    std::function<void (int)> onScanFinished;
+
+    juce::CriticalSection childLock;
+    juce::Array<juce::ChildProcess*> runningChildren;  // killed when the scan is stopped
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (PluginScanner)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginScanner)
+};
@@ -0,0 +1,159 @@
+#include "RenderCache.h"
+#include <tracktion_engine/tracktion_engine.h>
+#include <algorithm>
+
+namespace te = tracktion;
+
+namespace
+{
+    juce::uint64 fnv1a64 (const juce::String& text)
+    {
+        juce::uint64 hash = 0xcbf29ce484222325ull;
+
+        for (auto* p = text.toRawUTF8(); *p != 0; ++p)
+        {
+            hash ^= (juce::uint8) *p;
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+
+    // Renders are written into the store as .part files and renamed once complete. One that's
+    // still growing must survive eviction; one untouched for this long was left by a crash.
+    const auto partFileTimeout = juce::RelativeTime::hours (1);
+
+    bool isBeingWritten (const juce::File& f)
+    {
+        return f.hasFileExtension ("part")
+            && juce::Time::getCurrentTime() - f.getLastModificationTime() < partFileTimeout;
+    }
+
+    void removeVolatileProperties (juce::ValueTree v)
+    {
+        v.removeProperty (te::IDs::id, nullptr);
+
+        for (auto child : v)
+            removeVolatileProperties (child);
+    }
+}
+
+RenderCache::RenderCache (const juce::File& dir, juce::int64 maxSizeBytes)
+    : directory (dir), maxSize (maxSizeBytes)
+{
+}
+
+juce::String RenderCache::createKey (const juce::String& description)
+{
+    return juce::String::toHexString ((juce::int64) fnv1a64 (description)).paddedLeft ('0', 16)
+         + juce::String::toHexString (description.hashCode64()).paddedLeft ('0', 16);
+}
+
+juce::String RenderCache::describeFile (const juce::File& f)
+{
+    return f.getFullPathName() + "|" + juce::String (f.getSize()) + "|" + juce::String (f.getLastModificationTime().toMilliseconds());
+}
+
+juce::String RenderCache::describeState (const juce::ValueTree& state)
+{
+    auto copy = state.createCopy();
+    removeVolatileProperties (copy);
+    return copy.toXmlString();
+}
+
+juce::File RenderCache::getFileForKey (const juce::String& key, const juce::String& extension) const
+{
+    return directory.getChildFile (key).withFileExtension (extension);
+}
+
+juce::File RenderCache::find (const juce::String& key, const juce::String& extension)
+{
+    const juce::ScopedLock sl (lock);
+    auto f = getFileForKey (key, extension);
+
+    if (! f.existsAsFile())
+        return {};
+
+    f.setLastModificationTime (juce::Time::getCurrentTime());
+    return f;
+}
+
+juce::File RenderCache::lookup (const juce::String& key, const juce::String& extension) const
+{
+    auto f = getFileForKey (key, extension);
+    return f.existsAsFile() ? f : juce::File();
+}
+
+juce::File RenderCache::store (const juce::String& key, const juce::File& renderedFile)
+{
+    // A file this big would push out most of the store, and copying it costs about as much as
+    // rendering it again, so it isn't kept.
+    if (renderedFile.getSize() > maxSize / maxEntryFraction)
+        return {};
+
+    const juce::ScopedLock sl (lock);
+    auto dest = getFileForKey (key, renderedFile.getFileExtension());
+
+    if (! directory.createDirectory() || ! renderedFile.copyFileTo (dest))
+        return {};
+
+    evictIfNeeded (dest.getSize());
+    return dest;
+}
+
+void RenderCache::commit (const juce::File& fileInStore)
+{
+    const juce::ScopedLock sl (lock);
+    fileInStore.setLastModificationTime (juce::Time::getCurrentTime());
+    evictIfNeeded (fileInStore.getSize());
+}
+
+void RenderCache::setPinned (const juce::Array<juce::File>& files)
+{
+    const juce::ScopedLock sl (lock);
+    pinned = files;
+}
+
+void RenderCache::evictIfNeeded (juce::int64 addedBytes)
+{
+    // The folder is only listed once the running total says it may be full, so stores with
+    // many small entries don't pay for a directory scan on every write.
+    if (knownSize >= 0)
+    {
+        knownSize += addedBytes;
+
+        if (knownSize <= maxSize)
+            return;
+    }
+
+    auto files = directory.findChildFiles (juce::File::findFiles, false);
+    juce::int64 total = 0;
+
+    for (auto& f : files)
+        total += f.getSize();
+
+    knownSize = total;
+
+    if (total <= maxSize)
+        return;
+
+    std::sort (files.begin(), files.end(), [] (const juce::File& a, const juce::File& b)
+               {
+                   return a.getLastModificationTime() < b.getLastModificationTime();
+               });
+
+    for (auto& f : files)
+    {
+        if (total <= maxSize)
+            break;
+
+        if (pinned.contains (f) || isBeingWritten (f))
+            continue;
+
+        const auto size = f.getSize();
+        if (f.deleteFile())
+            total -= size;
+    }
+
+    knownSize = total;
+}
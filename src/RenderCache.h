@@ -0,0 +1,64 @@
+/*
+    Content-addressed store for rendered audio.
+
+    Files are keyed by a hash of everything that affects the render (source identity,
+    range, effect and plugin state, output settings), so an unchanged render can be
+    reused across exports, undo/redo and playback. The store is bounded in size and
+    evicts the least recently used files first.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class RenderCache
+{
+public:
+    RenderCache (const juce::File& directory, juce::int64 maxSizeBytes);
+
+    /** Returns a key for the given description; equal descriptions give equal keys. */
+    static juce::String createKey (const juce::String& description);
+
+    /** Describes a file by path, size and modification time. */
+    static juce::String describeFile (const juce::File&);
+
+    /** Describes a state tree, ignoring object IDs that change every time clips are rebuilt. */
+    static juce::String describeState (const juce::ValueTree&);
+
+    /** Returns the cached file for a key, or an empty File if there isn't one. A hit marks the file as recently used. */
+    juce::File find (const juce::String& key, const juce::String& extension);
+
+    /** Like find(), but leaves the file's modification time alone, for callers that describe
+        the file by it (e.g. edit lists naming a proxy) and would otherwise see it change.
+    */
+    juce::File lookup (const juce::String& key, const juce::String& extension) const;
+
+    /** Copies a rendered file into the store under the given key, evicting old entries if the store is too big.
+        Files larger than an eighth of the store's size aren't stored, and an empty File is returned.
+    */
+    juce::File store (const juce::String& key, const juce::File& renderedFile);
+
+    /** Returns where a key's file lives, so a render can be written straight into the store. Call commit() once it's complete.
+        Write to a ".part" extension and rename when done: eviction leaves .part files that are still being written alone.
+    */
+    juce::File getFileForKey (const juce::String& key, const juce::String& extension) const;
+    void commit (const juce::File& fileInStore);
+
+    /** Replaces the set of files eviction must leave alone, e.g. proxies that a live edit list reads. */
+    void setPinned (const juce::Array<juce::File>& files);
+
+    const juce::File& getDirectory() const      { return directory; }
+
+private:
+    void evictIfNeeded (juce::int64 addedBytes);
+
+    static constexpr juce::int64 maxEntryFraction = 8;
+
+    const juce::File directory;
+    const juce::int64 maxSize;
+    juce::CriticalSection lock;
+    juce::Array<juce::File> pinned;
+    juce::int64 knownSize = -1;                 // running total since the last scan, or -1 before the first
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderCache)
+};
@@ -0,0 +1,373 @@
+#include "RenderRegression.h"
+#include <fstream>
+
+namespace
+{
+    constexpr double sourceRate = 44100.0, sourceSeconds = 20.0;
+    constexpr int numTimingRuns = 3;
+    constexpr double pcmTolerance = 1.0e-4, lossyTolerance = 0.02;
+    constexpr double renderSampleRate = 44100.0;
+    constexpr int renderBlockSize = 512;
+    constexpr juce::int64 memorySlackKb = 16 * 1024;
+
+    struct Case
+    {
+        const char* name;
+        std::function<bool (IAudioEngine&, juce::String&)> apply;
+    };
+
+    te::TimeRange seconds (double start, double end)
+    {
+        return { te::TimePosition::fromSeconds (start), te::TimePosition::fromSeconds (end) };
+    }
+
+    const std::vector<Case>& getCases()
+    {
+        static const std::vector<Case> cases
+        {
+            { "unedited", [] (IAudioEngine&, juce::String&) { return true; } },
+
+            { "cut-paste", [] (IAudioEngine& e, juce::String&)
+                {
+                    return e.copySelection (seconds (2.0, 5.0))
+                            && e.pasteClipboard (te::TimePosition::fromSeconds (12.0))
+                            && e.deleteSelections (seconds (8.0, 9.0));
+                } },
+
+            { "multi-range-delete", [] (IAudioEngine& e, juce::String&)
+                {
+                    SelectionSet ranges;
+                    ranges.add (seconds (1.0, 1.5));
+                    ranges.add (seconds (4.0, 4.25));
+                    ranges.add (seconds (9.0, 10.5));
+                    return e.deleteSelections (ranges);
+                } },
+
+            { "normalise", [] (IAudioEngine& e, juce::String& status) { return e.normaliseRange (seconds (3.0, 7.0), status); } }
+        };
+
+        return cases;
+    }
+
+    const juce::StringArray& getExtensions()
+    {
+        static const juce::StringArray extensions { "wav", "aiff", "w64", "flac", "ogg", "mp3", "m4a" };
+        return extensions;
+    }
+
+    bool isLossy (const juce::String& extension)
+    {
+        return extension == "ogg" || extension == "mp3" || extension == "m4a";
+    }
+
+    // Tones on the left and seeded noise over a tone on the right, so every run gets the same source.
+    bool writeSource (const juce::File& file)
+    {
+        juce::WavAudioFormat wav;
+        auto out = file.createOutputStream();
+        std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? wav.createWriterFor (out.get(), sourceRate, 2, 24, {}, 0)
+                                                                        : nullptr);
+        if (writer == nullptr)
+            return false;
+
+        out.release();
+
+        juce::Random random (1234);
+        juce::AudioBuffer<float> buffer (2, (int) sourceRate);
+        juce::int64 pos = 0;
+
+        for (int second = 0; second < (int) sourceSeconds; ++second)
+        {
+            for (int i = 0; i < buffer.getNumSamples(); ++i, ++pos)
+            {
+                const auto t = (float) pos / (float) sourceRate;
+                const auto twoPi = juce::MathConstants<float>::twoPi;
+                buffer.setSample (0, i, 0.3f * std::sin (twoPi * 220.0f * t) + 0.1f * std::sin (twoPi * 1375.0f * t));
+                buffer.setSample (1, i, 0.2f * std::sin (twoPi * 330.0f * t) + 0.05f * (random.nextFloat() * 2.0f - 1.0f));
+            }
+
+            if (! writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples()))
+                return false;
+        }
+
+        return true;
+    }
+
+    struct Analysis
+    {
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        juce::int64 length = 0;
+        juce::String hash;
+        juce::Array<juce::var> peaks, rms;      // per 100 ms block, channels interleaved
+    };
+
+    bool analyse (juce::AudioFormatManager& formats, const juce::File& file, Analysis& result)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (file));
+        if (reader == nullptr || reader->sampleRate <= 0.0)
+            return false;
+
+        result.sampleRate = reader->sampleRate;
+        result.numChannels = (int) reader->numChannels;
+        result.length = reader->lengthInSamples;
+
+        const auto blockSize = juce::jmax (1, (int) (reader->sampleRate / 10.0));
+        juce::AudioBuffer<float> buffer (result.numChannels, blockSize);
+        juce::MemoryOutputStream samples;
+
+        for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += blockSize)
+        {
+            const auto numThisTime = (int) std::min<juce::int64> (blockSize, reader->lengthInSamples - pos);
+
+            if (! reader->read (&buffer, 0, numThisTime, pos, true, true))
+                return false;
+
+            for (int ch = 0; ch < result.numChannels; ++ch)
+            {
+                samples.write (buffer.getReadPointer (ch), (size_t) numThisTime * sizeof (float));
+                result.peaks.add (buffer.getMagnitude (ch, 0, numThisTime));
+                result.rms.add (buffer.getRMSLevel (ch, 0, numThisTime));
+            }
+        }
+
+        result.hash = juce::SHA256 (samples.getData(), samples.getDataSize()).toHexString();
+        return true;
+    }
+
+    double getMaxDifference (const juce::Array<juce::var>& measured, const juce::var& golden)
+    {
+        auto* goldenValues = golden.getArray();
+        if (goldenValues == nullptr || goldenValues->size() != measured.size())
+            return std::numeric_limits<double>::infinity();
+
+        double maxDifference = 0.0;
+
+        for (int i = 0; i < measured.size(); ++i)
+            maxDifference = std::max (maxDifference, std::abs ((double) measured[i] - (double) (*goldenValues)[i]));
+
+        return maxDifference;
+    }
+
+    // Peak resident memory since the last reset, from the kernel's high-water mark.
+    juce::int64 getPeakMemoryKb()
+    {
+       #if JUCE_LINUX
+        return juce::File ("/proc/self/status").loadFileAsString()
+                 .fromFirstOccurrenceOf ("VmHWM:", false, false).trim().getLargeIntValue();
+       #else
+        return -1;
+       #endif
+    }
+
+    void resetPeakMemory()
+    {
+       #if JUCE_LINUX
+        std::ofstream ("/proc/self/clear_refs") << "5";
+       #endif
+    }
+}
+
+bool RenderRegression::run (IAudioEngine& engine, IAudioExporter& exporter, const Options& options, juce::String& report)
+{
+    auto workDir = juce::File::getSpecialLocation (juce::File::tempDirectory)
+                     .getChildFile ("RenderRegression-" + juce::String::toHexString (juce::Random::getSystemRandom().nextInt()));
+    workDir.createDirectory();
+
+    const auto source = workDir.getChildFile ("source.wav");
+    if (! writeSource (source))
+    {
+        report << "Couldn't write the regression source\n";
+        workDir.deleteRecursively();
+        return false;
+    }
+
+    const auto goldens = options.updateGoldens ? juce::var() : juce::JSON::parse (options.manifest);
+    auto* goldenResults = goldens["results"].getDynamicObject();
+
+    if (! options.updateGoldens && goldenResults == nullptr)
+    {
+        report << "No goldens in " << options.manifest.getFullPathName() << "; run with --update-goldens first\n";
+        workDir.deleteRecursively();
+        return false;
+    }
+
+    auto& formats = engine.getEngine().getAudioFileFormatManager().readFormatManager;
+    juce::DynamicObject::Ptr results (new juce::DynamicObject());
+    bool allPassed = true;
+
+    for (auto& testCase : getCases())
+    {
+        for (auto& extension : getExtensions())
+        {
+            const auto name = juce::String (testCase.name) + "." + extension;
+            const auto dest = workDir.getChildFile (name);
+            juce::String status;
+
+            if (! engine.createNewEdit ("Render regression") || ! engine.loadFile (source, status)
+                 || ! testCase.apply (engine, status))
+            {
+                report << "FAIL " << name << "  couldn't apply the edit: " << status << "\n";
+                allPassed = false;
+                continue;
+            }
+
+            ExportContext context;
+            context.engine = &engine.getEngine();
+            context.edit = engine.getEdit();
+            context.fullRange = seconds (0.0, engine.getTotalLength().inSeconds());
+            context.renderSampleRate = renderSampleRate;
+            context.renderBlockSize = renderBlockSize;
+
+            // The best of a few runs, so a scheduling hiccup doesn't read as a slowdown.
+            double bestSeconds = std::numeric_limits<double>::max();
+            juce::int64 peakKb = -1;
+            Analysis analysis;
+            bool exported = true, deterministic = true;
+
+            for (int run = 0; run < numTimingRuns && exported; ++run)
+            {
+                dest.deleteFile();
+                resetPeakMemory();
+
+                const auto start = juce::Time::getMillisecondCounterHiRes();
+                exported = exporter.exportRange (context, context.fullRange, dest, status);
+                bestSeconds = std::min (bestSeconds, (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0);
+                peakKb = std::max (peakKb, getPeakMemoryKb());
+
+                Analysis runAnalysis;
+                if (exported && ! analyse (formats, dest, runAnalysis))
+                {
+                    exported = false;
+                    status = "couldn't read the render back";
+                }
+
+                if (run == 0)
+                    analysis = runAnalysis;
+                else
+                    deterministic = deterministic && runAnalysis.hash == analysis.hash;
+            }
+
+            dest.deleteFile();
+
+            if (! exported)
+            {
+                // Formats this platform can't write (MP3 or M4A without an encoder) are skipped.
+                const bool unsupported = status.startsWith ("Unsupported");
+                report << (unsupported ? "SKIP " : "FAIL ") << name << "  " << status << "\n";
+                allPassed = allPassed && unsupported;
+                continue;
+            }
+
+            const auto realtimeFactor = context.fullRange.getLength().inSeconds() / juce::jmax (1.0e-6, bestSeconds);
+
+            juce::DynamicObject::Ptr result (new juce::DynamicObject());
+            result->setProperty ("hash", analysis.hash);
+            result->setProperty ("sampleRate", analysis.sampleRate);
+            result->setProperty ("numChannels", analysis.numChannels);
+            result->setProperty ("length", analysis.length);
+            result->setProperty ("peaks", analysis.peaks);
+            result->setProperty ("rms", analysis.rms);
+            result->setProperty ("realtimeFactor", realtimeFactor);
+            result->setProperty ("peakMemoryKb", peakKb);
+            results->setProperty (name, juce::var (result.get()));
+
+            juce::String line;
+            line << name.paddedRight (' ', 26) << "  " << juce::String (realtimeFactor, 1) << "x realtime";
+
+            if (peakKb >= 0)
+                line << ", peak " << peakKb / 1024 << " MB";
+
+            // Lossy encoders may legitimately vary; PCM renders of the same edit must not.
+            const bool nondeterministic = ! deterministic && ! isLossy (extension);
+
+            if (! deterministic && ! nondeterministic)
+                line << ", output differs between runs";
+
+            juce::StringArray problems;
+
+            if (nondeterministic)
+                problems.add ("output differs between runs");
+
+            if (options.updateGoldens)
+            {
+                allPassed = allPassed && problems.isEmpty();
+                report << (problems.isEmpty() ? "SAVE " : "FAIL ") << line;
+
+                if (! problems.isEmpty())
+                    report << "  <-- " << problems.joinIntoString ("; ");
+
+                report << "\n";
+                continue;
+            }
+
+            const auto golden = goldenResults->getProperty (name);
+
+            if (golden.isVoid())
+            {
+                problems.add ("no golden");
+            }
+            else if (analysis.hash == golden["hash"].toString())
+            {
+                line << ", identical";
+            }
+            else if (analysis.length != (juce::int64) golden["length"] || analysis.numChannels != (int) golden["numChannels"]
+                      || analysis.sampleRate != (double) golden["sampleRate"])
+            {
+                problems.add ("format or length changed");
+            }
+            else
+            {
+                const auto tolerance = isLossy (extension) ? lossyTolerance : pcmTolerance;
+                const auto difference = std::max (getMaxDifference (analysis.peaks, golden["peaks"]),
+                                                  getMaxDifference (analysis.rms, golden["rms"]));
+
+                if (difference > tolerance)
+                    problems.add ("audio differs by " + juce::String (difference, 6) + " (tolerance " + juce::String (tolerance, 6) + ")");
+                else
+                    line << ", within tolerance";
+            }
+
+            if (! golden.isVoid())
+            {
+                const auto goldenFactor = (double) golden["realtimeFactor"];
+                if (realtimeFactor < goldenFactor * (1.0 - options.maxSlowdown))
+                    problems.add ("slower than the golden " + juce::String (goldenFactor, 1) + "x");
+
+                const auto goldenKb = (juce::int64) golden["peakMemoryKb"];
+                if (peakKb >= 0 && goldenKb > 0 && peakKb > (juce::int64) ((double) goldenKb * (1.0 + options.maxMemoryGrowth)) + memorySlackKb)
+                    problems.add ("peak memory above the golden " + juce::String (goldenKb / 1024) + " MB");
+            }
+
+            allPassed = allPassed && problems.isEmpty();
+            report << (problems.isEmpty() ? "PASS " : "FAIL ") << line;
+
+            if (! problems.isEmpty())
+                report << "  <-- " << problems.joinIntoString ("; ");
+
+            report << "\n";
+        }
+    }
+
+    workDir.deleteRecursively();
+
+    if (options.updateGoldens)
+    {
+        juce::DynamicObject::Ptr manifest (new juce::DynamicObject());
+        manifest->setProperty ("version", 1);
+        manifest->setProperty ("results", juce::var (results.get()));
+
+        options.manifest.getParentDirectory().createDirectory();
+        if (! options.manifest.replaceWithText (juce::JSON::toString (juce::var (manifest.get()))))
+        {
+            report << "Couldn't write " << options.manifest.getFullPathName() << "\n";
+            return false;
+        }
+
+        report << "Goldens written to " << options.manifest.getFullPathName() << "\n";
+        return true;
+    }
+
+    report << (allPassed ? "All renders match the goldens\n" : "Render regression FAILED\n");
+    return allPassed;
+}
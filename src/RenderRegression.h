@@ -0,0 +1,38 @@
+/*
+    Render regression harness.
+
+    Renders a fixed corpus (a generated source put through a few typical edits) to every
+    export format through IAudioExporter::exportRange(), exactly as a scripted export would,
+    and compares each result with a golden manifest. Every render is checked for:
+    - decoded audio: a SHA-256 of the samples, then per-block peak and RMS within a tolerance
+      when the hash differs (dither and lossy encoders aren't bit-exact everywhere)
+    - determinism: PCM renders must decode identically on every run
+    - the realtime factor: the best of a few runs, which must not fall too far below the golden
+    - peak resident memory (VmHWM, Linux only), which must not grow too far past the golden
+
+    Runs on a headless engine that never opens an audio device, and renders at a fixed rate and
+    block size, so results don't depend on the machine's audio setup.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioEngine.h"
+#include "AudioExporter.h"
+
+class RenderRegression
+{
+public:
+    struct Options
+    {
+        juce::File manifest;                // golden results, as JSON
+        bool updateGoldens = false;         // record this run as the new goldens instead of comparing
+        double maxSlowdown = 0.25;          // fail when the realtime factor drops by more than this fraction
+        double maxMemoryGrowth = 0.25;      // fail when peak memory grows by more than this fraction
+    };
+
+    /** Renders and checks the whole corpus, appending a line per render to report.
+        Returns true if every render passed (or the goldens were written).
+    */
+    static bool run (IAudioEngine&, IAudioExporter&, const Options&, juce::String& report);
+};
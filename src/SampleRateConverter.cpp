@@ -0,0 +1,405 @@
+#include "SampleRateConverter.h"
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    struct QualitySettings
+    {
+        double stopbandAttenuationDb;
+        double passbandFraction;        // of the output Nyquist frequency (or the input's, when upsampling)
+    };
+
+    QualitySettings getSettings (SampleRateConverter::Quality quality)
+    {
+        switch (quality)
+        {
+            case SampleRateConverter::Quality::fast:       return { 60.0,  0.90 };
+            case SampleRateConverter::Quality::standard:   return { 90.0,  0.93 };
+            case SampleRateConverter::Quality::high:       return { 120.0, 0.95 };
+            case SampleRateConverter::Quality::best:       return { 150.0, 0.97 };
+        }
+
+        return { 90.0, 0.93 };
+    }
+
+    double besselI0 (double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; k < 50; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+
+            if (term < sum * 1.0e-12)
+                break;
+        }
+
+        return sum;
+    }
+
+    double sinc (double x)
+    {
+        return std::abs (x) < 1.0e-9 ? 1.0 : std::sin (juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+    }
+
+    constexpr int fileBlockSize = 16384;
+}
+
+SampleRateConverter::Quality SampleRateConverter::getQualityForName (const juce::String& name)
+{
+    const auto index = getQualityNames().indexOf (name, true);
+    return index < 0 ? Quality::standard : (Quality) index;
+}
+
+SampleRateConverter::SampleRateConverter (double inRate, double outRate, Quality quality)
+    : inputRate (inRate), outputRate (outRate)
+{
+    const auto in = (int) std::round (inputRate);
+    const auto out = (int) std::round (outputRate);
+    const auto divisor = std::gcd (in, out);
+    upFactor = out / divisor;
+    downFactor = in / divisor;
+
+    const auto settings = getSettings (quality);
+    const auto attenuation = settings.stopbandAttenuationDb;
+    const auto beta = attenuation > 50.0 ? 0.1102 * (attenuation - 8.7)
+                                         : 0.5842 * std::pow (attenuation - 21.0, 0.4) + 0.07886 * (attenuation - 21.0);
+
+    // Frequencies in cycles per input sample. The stopband starts at the lower of the two
+    // Nyquist frequencies, so nothing that would alias (or image, when upsampling) gets past
+    // the attenuation the preset promises, and the cutoff sits halfway across the transition band.
+    const auto stopbandEdge = 0.5 * std::min (1.0, outputRate / inputRate);
+    const auto transitionWidth = stopbandEdge * (1.0 - settings.passbandFraction);
+    const auto cutoff = 2.0 * (stopbandEdge - 0.5 * transitionWidth);
+
+    // Kaiser's estimate of the length that reaches the attenuation over that transition. Taps are
+    // counted in input samples, so downsampling, which narrows the band, takes proportionally more.
+    // Rounded up to a multiple of four for dot().
+    const auto kaiserLength = (attenuation - 7.95) / (14.36 * transitionWidth) + 1.0;
+    numTaps = ((int) std::ceil (kaiserLength) + 3) & ~3;
+    const auto halfLength = numTaps / 2;
+
+    // Phase p filters the input at fractional position p / upFactor. Taps are laid out in input
+    // order so each output is one forward dot product, and each phase is normalised to unity DC gain.
+    coefficients.resize ((size_t) upFactor * (size_t) numTaps);
+
+    for (int phase = 0; phase < upFactor; ++phase)
+    {
+        auto* h = coefficients.data() + (size_t) phase * (size_t) numTaps;
+        double sum = 0.0;
+
+        for (int k = 0; k < numTaps; ++k)
+        {
+            const auto distance = (double) (k - halfLength + 1) - (double) phase / upFactor;
+            const auto r = distance / halfLength;
+            const auto window = std::abs (r) <= 1.0 ? besselI0 (beta * std::sqrt (1.0 - r * r)) / besselI0 (beta) : 0.0;
+            const auto value = cutoff * sinc (cutoff * distance) * window;
+            h[k] = (float) value;
+            sum += value;
+        }
+
+        for (int k = 0; k < numTaps; ++k)
+            h[k] = (float) (h[k] / sum);
+    }
+}
+
+float SampleRateConverter::dot (const float* input, int phase) const noexcept
+{
+    const auto* h = coefficients.data() + (size_t) phase * (size_t) numTaps;
+
+    // Four independent accumulators keep the loop free of a serial dependency so the
+    // compiler can vectorise it; the constructor rounds the tap count up to a multiple of four.
+    float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+
+    for (int k = 0; k < numTaps; k += 4)
+    {
+        a0 += input[k]     * h[k];
+        a1 += input[k + 1] * h[k + 1];
+        a2 += input[k + 2] * h[k + 2];
+        a3 += input[k + 3] * h[k + 3];
+    }
+
+    return (a0 + a1) + (a2 + a3);
+}
+
+SampleRateConverter::Channel::Channel (const SampleRateConverter& c)
+    : converter (c)
+{
+    // The first output is centred on input sample 0, so the filter starts half a length before it.
+    const auto lead = converter.numTaps / 2 - 1;
+    buffer.assign ((size_t) lead, 0.0f);
+    bufferStart = -lead;
+}
+
+void SampleRateConverter::Channel::process (const float* input, int numSamples, std::vector<float>& output)
+{
+    buffer.insert (buffer.end(), input, input + numSamples);
+    inputCount += numSamples;
+    produce (output, std::numeric_limits<juce::int64>::max());
+}
+
+void SampleRateConverter::Channel::finish (std::vector<float>& output)
+{
+    buffer.insert (buffer.end(), (size_t) converter.numTaps, 0.0f);
+
+    const auto expectedOutput = (inputCount * converter.upFactor + converter.downFactor - 1) / converter.downFactor;
+    produce (output, expectedOutput);
+}
+
+void SampleRateConverter::Channel::produce (std::vector<float>& output, juce::int64 maxOutputCount)
+{
+    const auto halfLength = converter.numTaps / 2;
+    const auto bufferEnd = bufferStart + (juce::int64) buffer.size();
+
+    while (outputCount < maxOutputCount)
+    {
+        const auto position = outputCount * converter.downFactor;
+        const auto index = position / converter.upFactor;
+        const auto phase = (int) (position % converter.upFactor);
+
+        if (index + halfLength >= bufferEnd)
+            break;
+
+        output.push_back (converter.dot (buffer.data() + (index - halfLength + 1 - bufferStart), phase));
+        ++outputCount;
+    }
+
+    // Drop input that no later output can reach.
+    const auto firstNeeded = (outputCount * converter.downFactor) / converter.upFactor - halfLength + 1;
+    const auto discard = firstNeeded - bufferStart;
+
+    if (discard > 4096)
+    {
+        buffer.erase (buffer.begin(), buffer.begin() + (std::ptrdiff_t) discard);
+        bufferStart += discard;
+    }
+}
+
+bool SampleRateConverter::convertFile (const juce::File& sourceWav, const juce::File& destFile, juce::AudioFormat& destFormat,
+                                       double outputRate, int bitDepth, int qualityOptionIndex, bool dither,
+                                       Quality quality, std::atomic<float>& progress)
+{
+    juce::WavAudioFormat wav;
+    auto openSource = [&]
+    {
+        return std::unique_ptr<juce::AudioFormatReader> (wav.createReaderFor (sourceWav.createInputStream().release(), true));
+    };
+
+    auto reader = openSource();
+    if (reader == nullptr)
+        return false;
+
+    const auto numChannels = (int) reader->numChannels;
+    const auto totalInput = reader->lengthInSamples;
+    const SampleRateConverter converter (reader->sampleRate, outputRate, quality);
+
+    std::vector<std::unique_ptr<juce::TemporaryFile>> channelFiles;
+    for (int ch = 0; ch < numChannels; ++ch)
+        channelFiles.push_back (std::make_unique<juce::TemporaryFile> (".raw"));
+
+    std::atomic<juce::int64> samplesDone { 0 };
+    std::atomic<bool> failed { false };
+
+    {
+        juce::ThreadPool pool (numChannels);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            pool.addJob ([&, ch]
+            {
+                auto channelReader = openSource();
+                juce::FileOutputStream out (channelFiles[(size_t) ch]->getFile());
+
+                if (channelReader == nullptr || ! out.openedOk())
+                {
+                    failed = true;
+                    return;
+                }
+
+                Channel channel (converter);
+                juce::AudioBuffer<float> block (numChannels, fileBlockSize);
+                std::vector<float> produced;
+
+                for (juce::int64 pos = 0; pos < totalInput && ! failed; pos += fileBlockSize)
+                {
+                    const auto numThisTime = (int) std::min<juce::int64> (fileBlockSize, totalInput - pos);
+                    channelReader->read (&block, 0, numThisTime, pos, true, true);
+
+                    produced.clear();
+                    channel.process (block.getReadPointer (ch), numThisTime, produced);
+                    out.write (produced.data(), produced.size() * sizeof (float));
+
+                    samplesDone += numThisTime;
+                    progress = 0.8f * (float) samplesDone.load() / (float) std::max<juce::int64> (1, totalInput * numChannels);
+                }
+
+                produced.clear();
+                channel.finish (produced);
+                out.write (produced.data(), produced.size() * sizeof (float));
+                out.flush();
+
+                if (out.getStatus().failed())
+                    failed = true;
+            });
+        }
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (10);
+    }
+
+    if (failed)
+        return false;
+
+    destFile.deleteFile();
+    auto outStream = destFile.createOutputStream();
+    if (outStream == nullptr)
+        return false;
+
+    std::unique_ptr<juce::AudioFormatWriter> writer (destFormat.createWriterFor (outStream.get(), outputRate, (unsigned int) numChannels,
+                                                                                 bitDepth, {}, qualityOptionIndex));
+    if (writer == nullptr)
+        return false;
+
+    outStream.release();
+
+    std::vector<std::unique_ptr<juce::FileInputStream>> inputs;
+    juce::int64 totalOutput = std::numeric_limits<juce::int64>::max();
+
+    for (auto& f : channelFiles)
+    {
+        inputs.push_back (f->getFile().createInputStream());
+        if (inputs.back() == nullptr)
+            return false;
+
+        totalOutput = std::min (totalOutput, inputs.back()->getTotalLength() / (juce::int64) sizeof (float));
+    }
+
+    // TPDF dither of one LSB at the destination bit depth.
+    const auto lsb = dither && bitDepth < 32 ? 1.0f / (float) (1 << (bitDepth - 1)) : 0.0f;
+    juce::Random random;
+    juce::AudioBuffer<float> block (numChannels, fileBlockSize);
+
+    for (juce::int64 pos = 0; pos < totalOutput; pos += fileBlockSize)
+    {
+        const auto numThisTime = (int) std::min<juce::int64> (fileBlockSize, totalOutput - pos);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* data = block.getWritePointer (ch);
+            inputs[(size_t) ch]->read (data, numThisTime * (int) sizeof (float));
+
+            if (lsb > 0.0f)
+                for (int i = 0; i < numThisTime; ++i)
+                    data[i] += (random.nextFloat() - random.nextFloat()) * lsb;
+        }
+
+        if (! writer->writeFromAudioSampleBuffer (block, 0, numThisTime))
+            return false;
+
+        progress = 0.8f + 0.2f * (float) pos / (float) std::max<juce::int64> (1, totalOutput);
+    }
+
+    progress = 1.0f;
+    return true;
+}
+
+juce::String SampleRateConverter::runBenchmark()
+{
+    struct Conversion
+    {
+        double inputRate, outputRate;
+    };
+
+    const Conversion conversions[] = { { 48000.0, 44100.0 }, { 44100.0, 48000.0 }, { 44100.0, 96000.0 }, { 96000.0, 44100.0 } };
+    constexpr double amplitude = 0.5;
+
+    auto convert = [] (const SampleRateConverter& src, const std::vector<float>& input)
+    {
+        std::vector<float> output;
+        Channel channel (src);
+        channel.process (input.data(), (int) input.size(), output);
+        channel.finish (output);
+        return output;
+    };
+
+    auto makeTone = [] (double frequency, double rate, int numSamples)
+    {
+        std::vector<float> tone ((size_t) numSamples);
+        for (int i = 0; i < numSamples; ++i)
+            tone[(size_t) i] = (float) (amplitude * std::sin (juce::MathConstants<double>::twoPi * frequency * i / rate));
+        return tone;
+    };
+
+    juce::String report ("Sample-rate converter benchmark\n");
+    report << "conversion        preset     passband err  worst SNR   rejection   throughput\n";
+
+    for (auto& c : conversions)
+    {
+        for (auto& name : getQualityNames())
+        {
+            const SampleRateConverter src (c.inputRate, c.outputRate, getQualityForName (name));
+            const auto lowerNyquist = 0.5 * std::min (c.inputRate, c.outputRate);
+
+            // In-band tones: compare against the ideal tone at the output rate. The filter is
+            // centred, so output n lines up exactly with input time n / outputRate.
+            double worstGainErrorDb = 0.0, worstSnrDb = 1000.0;
+
+            for (auto fraction : { 0.01, 0.1, 0.5, 0.85 })
+            {
+                const auto frequency = fraction * lowerNyquist;
+                const auto output = convert (src, makeTone (frequency, c.inputRate, (int) c.inputRate));
+                const auto skip = (size_t) src.numTaps * 4;
+
+                double signal = 0.0, error = 0.0, measured = 0.0;
+
+                for (size_t n = skip; n + skip < output.size(); ++n)
+                {
+                    const auto ideal = amplitude * std::sin (juce::MathConstants<double>::twoPi * frequency * (double) n / c.outputRate);
+                    signal += ideal * ideal;
+                    measured += (double) output[n] * output[n];
+                    error += (output[n] - ideal) * (output[n] - ideal);
+                }
+
+                worstGainErrorDb = std::max (worstGainErrorDb, std::abs (10.0 * std::log10 (measured / signal)));
+                worstSnrDb = std::min (worstSnrDb, 10.0 * std::log10 (signal / std::max (error, 1.0e-30)));
+            }
+
+            // Rejection: a tone between the output and input Nyquist frequencies must not alias back in.
+            juce::String rejection ("n/a");
+            if (c.outputRate < c.inputRate)
+            {
+                const auto frequency = 0.5 * (0.5 * c.outputRate + 0.5 * c.inputRate);
+                const auto output = convert (src, makeTone (frequency, c.inputRate, (int) c.inputRate));
+
+                double energy = 0.0;
+                for (auto s : output)
+                    energy += (double) s * s;
+
+                const auto rms = std::sqrt (energy / (double) std::max<size_t> (1, output.size()));
+                rejection = juce::String (20.0 * std::log10 (std::max (rms, 1.0e-12) / (amplitude / std::sqrt (2.0))), 1) + " dB";
+            }
+
+            // Throughput on ten seconds of noise.
+            juce::Random random (1);
+            std::vector<float> noise ((size_t) (c.inputRate * 10.0));
+            for (auto& s : noise)
+                s = random.nextFloat() - 0.5f;
+
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+            const auto output = convert (src, noise);
+            const auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+            report << juce::String (c.inputRate / 1000.0, 1) << "k -> " << juce::String (c.outputRate / 1000.0, 1) << "k"
+                   << "   " << name.paddedRight (' ', 10)
+                   << juce::String (worstGainErrorDb, 4) << " dB   "
+                   << juce::String (worstSnrDb, 1) << " dB   "
+                   << rejection << "   "
+                   << juce::String ((double) noise.size() / seconds / 1.0e6, 1) << " Msamples/s ("
+                   << juce::String (10.0 / seconds, 0) << "x realtime, " << (int) output.size() << " out)\n";
+        }
+    }
+
+    return report;
+}
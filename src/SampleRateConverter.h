@@ -0,0 +1,69 @@
+/*
+    Polyphase windowed-sinc sample-rate converter used by the export path.
+
+    The conversion ratio is reduced to L/M, and the Kaiser-windowed sinc is stored as L
+    phases of N taps each, so every output sample is a single contiguous N-tap dot product.
+    Quality presets trade stopband attenuation and passband width for speed; the taps per
+    phase follow from them by Kaiser's formula, so downsampling ratios get longer filters.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+class SampleRateConverter
+{
+public:
+    enum class Quality
+    {
+        fast,
+        standard,
+        high,
+        best
+    };
+
+    static juce::StringArray getQualityNames()        { return { "Fast", "Standard", "High", "Best" }; }
+    static Quality getQualityForName (const juce::String&);
+
+    SampleRateConverter (double inputRate, double outputRate, Quality);
+
+    /** Streams one channel: feed input blocks with process(), then call finish() once. */
+    class Channel
+    {
+    public:
+        explicit Channel (const SampleRateConverter&);
+
+        void process (const float* input, int numSamples, std::vector<float>& output);
+        void finish (std::vector<float>& output);
+
+    private:
+        void produce (std::vector<float>& output, juce::int64 maxOutputCount);
+
+        const SampleRateConverter& converter;
+        std::vector<float> buffer;
+        juce::int64 bufferStart = 0, inputCount = 0, outputCount = 0;
+    };
+
+    double getInputRate() const noexcept      { return inputRate; }
+    double getOutputRate() const noexcept     { return outputRate; }
+
+    /** Converts a float WAV to outputRate and writes it with the given format. Each channel
+        is resampled on its own thread into a temporary file and then interleaved into the
+        destination, so memory use doesn't depend on the length of the file.
+    */
+    static bool convertFile (const juce::File& sourceWav, const juce::File& destFile, juce::AudioFormat& destFormat,
+                             double outputRate, int bitDepth, int qualityOptionIndex, bool dither,
+                             Quality, std::atomic<float>& progress);
+
+    /** Measures passband error, rejection above the output Nyquist and throughput for each preset. */
+    static juce::String runBenchmark();
+
+private:
+    float dot (const float* input, int phase) const noexcept;
+
+    double inputRate, outputRate;
+    int upFactor = 1, downFactor = 1, numTaps = 0;
+    std::vector<float> coefficients;
+};
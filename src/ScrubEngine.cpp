@@ -0,0 +1,169 @@
+#include "ScrubEngine.h"
+#include <cmath>
+
+namespace
+{
+    // Catmull-Rom cubic through four neighbouring samples, x in [0, 1) between y1 and y2.
+    inline float cubicInterpolate (float y0, float y1, float y2, float y3, float x) noexcept
+    {
+        const auto c1 = 0.5f * (y2 - y0);
+        const auto c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+        const auto c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+        return ((c3 * x + c2) * x + c1) * x + y1;
+    }
+}
+
+ScrubEngine::ScrubEngine (juce::TimeSliceThread& backgroundThreadToUse)
+    : backgroundThread (backgroundThreadToUse)
+{
+}
+
+ScrubEngine::~ScrubEngine()
+{
+    stop();
+}
+
+void ScrubEngine::start (std::unique_ptr<juce::AudioFormatReader> timelineReader, double startSeconds, double initialSpeed)
+{
+    stop();
+
+    if (timelineReader == nullptr || timelineReader->lengthInSamples <= 0)
+        return;
+
+    {
+        const juce::ScopedLock sl (readerLock);
+        reader = std::move (timelineReader);
+        sourceSampleRate = reader->sampleRate;
+        sourceLength = reader->lengthInSamples;
+    }
+
+    const auto startSample = juce::jlimit (0.0, (double) sourceLength, startSeconds * sourceSampleRate);
+    position.store (startSample);
+    targetSpeed.store (initialSpeed);
+    currentIncrement = 0.0;
+
+    // Fill the first window here so the very first block after the key press has audio.
+    fillWindowAround ((juce::int64) startSample);
+
+    active.store (true);
+    backgroundThread.addTimeSliceClient (this);
+}
+
+double ScrubEngine::stop()
+{
+    backgroundThread.removeTimeSliceClient (this);
+    active.store (false);
+
+    {
+        const juce::SpinLock::ScopedLockType sl (bufferLock);
+        windowLength = 0;
+    }
+
+    {
+        const juce::ScopedLock sl (readerLock);
+        reader.reset();
+    }
+
+    return getPositionSeconds();
+}
+
+double ScrubEngine::getPositionSeconds() const noexcept
+{
+    return sourceSampleRate > 0.0 ? position.load() / sourceSampleRate : 0.0;
+}
+
+bool ScrubEngine::fillWindowAround (juce::int64 centreSample)
+{
+    const juce::ScopedLock sl (readerLock);
+
+    if (reader == nullptr)
+        return false;
+
+    const auto newStart = juce::jlimit ((juce::int64) 0, std::max ((juce::int64) 0, sourceLength - windowSamples),
+                                        centreSample - windowSamples / 2);
+    const auto newLength = (int) std::min ((juce::int64) windowSamples, sourceLength - newStart);
+
+    staging.setSize ((int) reader->numChannels, windowSamples, false, false, true);
+    reader->read (&staging, 0, newLength, newStart, true, true);
+
+    const juce::SpinLock::ScopedLockType bl (bufferLock);
+    std::swap (window, staging);
+    windowStart = newStart;
+    windowLength = newLength;
+    return true;
+}
+
+int ScrubEngine::useTimeSlice()
+{
+    if (! active.load())
+        return -1;
+
+    const auto pos = (juce::int64) position.load();
+    const auto margin = windowSamples / 4;
+
+    const bool nearStart = windowStart > 0 && pos - windowStart < margin;
+    const bool nearEnd = windowStart + windowLength < sourceLength && windowStart + windowLength - pos < margin;
+
+    if (windowLength == 0 || nearStart || nearEnd)
+        fillWindowAround (pos);
+
+    return 5;
+}
+
+void ScrubEngine::audioDeviceIOCallbackWithContext (const float* const*, int,
+                                                    float* const* outputChannelData, int numOutputChannels,
+                                                    int numSamples, const juce::AudioIODeviceCallbackContext&)
+{
+    for (int ch = 0; ch < numOutputChannels; ++ch)
+        if (outputChannelData[ch] != nullptr)
+            juce::FloatVectorOperations::clear (outputChannelData[ch], numSamples);
+
+    if (! active.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType sl (bufferLock);
+    if (! sl.isLocked() || windowLength < 4)
+        return;
+
+    const auto numSourceChannels = window.getNumChannels();
+    const auto ratio = sourceSampleRate / deviceSampleRate.load();
+    const auto targetIncrement = targetSpeed.load() * ratio;
+    const auto incrementStep = (targetIncrement - currentIncrement) / numSamples;
+    auto pos = position.load();
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        currentIncrement += incrementStep;
+
+        const auto local = pos - (double) windowStart;
+        const auto index = (int) std::floor (local);
+
+        if (index >= 1 && index < windowLength - 2)
+        {
+            const auto frac = (float) (local - index);
+
+            for (int ch = 0; ch < numOutputChannels; ++ch)
+            {
+                if (outputChannelData[ch] == nullptr)
+                    continue;
+
+                const auto* src = window.getReadPointer (std::min (ch, numSourceChannels - 1), index - 1);
+                outputChannelData[ch][i] = cubicInterpolate (src[0], src[1], src[2], src[3], frac);
+            }
+        }
+
+        pos = juce::jlimit (0.0, (double) sourceLength, pos + currentIncrement);
+    }
+
+    position.store (pos);
+}
+
+void ScrubEngine::audioDeviceAboutToStart (juce::AudioIODevice* device)
+{
+    if (device != nullptr && device->getCurrentSampleRate() > 0.0)
+        deviceSampleRate.store (device->getCurrentSampleRate());
+}
+
+void ScrubEngine::audioDeviceStopped()
+{
+}
@@ -0,0 +1,69 @@
+/*
+    Varispeed scrub playback that runs on the audio thread.
+
+    A background thread keeps a window of decoded audio around the scrub position;
+    the device callback reads from that window with a cubic resampler, so speed and
+    direction changes are heard within one audio block.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+
+class ScrubEngine : public juce::AudioIODeviceCallback,
+                    private juce::TimeSliceClient
+{
+public:
+    explicit ScrubEngine (juce::TimeSliceThread& backgroundThreadToUse);
+    ~ScrubEngine() override;
+
+    /** Starts scrubbing from startSeconds. The reader should present the edited timeline
+        (e.g. an EditListAudioFormatReader). Call from the message thread.
+    */
+    void start (std::unique_ptr<juce::AudioFormatReader> timelineReader, double startSeconds, double initialSpeed);
+
+    /** Sets the playback speed, 1.0 being normal speed. Negative speeds play in reverse.
+        Safe to call from any thread.
+    */
+    void setSpeed (double newSpeed) noexcept            { targetSpeed.store (newSpeed); }
+
+    /** Stops scrubbing and returns the final position in seconds. */
+    double stop();
+
+    bool isActive() const noexcept                      { return active.load(); }
+    double getPositionSeconds() const noexcept;
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                           float* const* outputChannelData, int numOutputChannels,
+                                           int numSamples, const juce::AudioIODeviceCallbackContext&) override;
+    void audioDeviceAboutToStart (juce::AudioIODevice*) override;
+    void audioDeviceStopped() override;
+
+private:
+    int useTimeSlice() override;
+    bool fillWindowAround (juce::int64 centreSample);
+
+    static constexpr int windowSamples = 1 << 18;
+
+    juce::TimeSliceThread& backgroundThread;
+
+    juce::CriticalSection readerLock;
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    double sourceSampleRate = 44100.0;
+    juce::int64 sourceLength = 0;
+
+    juce::SpinLock bufferLock;
+    juce::AudioBuffer<float> window, staging;
+    juce::int64 windowStart = 0;
+    int windowLength = 0;
+
+    std::atomic<bool> active { false };
+    std::atomic<double> targetSpeed { 1.0 };
+    std::atomic<double> position { 0.0 };
+    std::atomic<double> deviceSampleRate { 44100.0 };
+    double currentIncrement = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScrubEngine)
+};
@@ -0,0 +1,70 @@
+#include "SelectionSet.h"
+#include <algorithm>
+
+void SelectionSet::add (te::TimeRange range)
+{
+    if (range.isEmpty())
+        return;
+
+    // Everything from the first range ending at or after the new start to the last one
+    // starting at or before the new end is merged into it.
+    auto first = std::lower_bound (ranges.begin(), ranges.end(), range.getStart(),
+                                   [] (te::TimeRange r, te::TimePosition t) { return r.getEnd() < t; });
+    auto last = std::upper_bound (first, ranges.end(), range.getEnd(),
+                                  [] (te::TimePosition t, te::TimeRange r) { return t < r.getStart(); });
+
+    if (first != last)
+        range = { std::min (range.getStart(), first->getStart()), std::max (range.getEnd(), (last - 1)->getEnd()) };
+
+    ranges.insert (ranges.erase (first, last), range);
+}
+
+void SelectionSet::remove (te::TimeRange range)
+{
+    if (range.isEmpty())
+        return;
+
+    std::vector<te::TimeRange> remaining;
+    remaining.reserve (ranges.size() + 1);
+
+    for (auto& r : ranges)
+    {
+        if (! r.overlaps (range))
+        {
+            remaining.push_back (r);
+            continue;
+        }
+
+        if (r.getStart() < range.getStart())
+            remaining.push_back ({ r.getStart(), range.getStart() });
+
+        if (r.getEnd() > range.getEnd())
+            remaining.push_back ({ range.getEnd(), r.getEnd() });
+    }
+
+    ranges = std::move (remaining);
+}
+
+bool SelectionSet::contains (te::TimePosition position) const
+{
+    auto it = std::upper_bound (ranges.begin(), ranges.end(), position,
+                                [] (te::TimePosition t, te::TimeRange r) { return t < r.getStart(); });
+
+    return it != ranges.begin() && (it - 1)->contains (position);
+}
+
+te::TimeDuration SelectionSet::getTotalLength() const
+{
+    te::TimeDuration total;
+    for (auto& r : ranges)
+        total = total + r.getLength();
+    return total;
+}
+
+te::TimeRange SelectionSet::getBounds() const
+{
+    if (ranges.empty())
+        return {};
+
+    return { ranges.front().getStart(), ranges.back().getEnd() };
+}
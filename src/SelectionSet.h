@@ -0,0 +1,37 @@
+/*
+    A set of disjoint timeline ranges.
+
+    Adding a range merges it with any it overlaps or touches, so the set stays sorted and
+    disjoint and batched edits can walk it alongside the segment list in a single pass.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <tracktion_engine/tracktion_engine.h>
+#include <vector>
+
+namespace te = tracktion;
+
+class SelectionSet
+{
+public:
+    SelectionSet() = default;
+    SelectionSet (te::TimeRange range)                  { add (range); }
+
+    void add (te::TimeRange);
+    void remove (te::TimeRange);
+    void clear()                                        { ranges.clear(); }
+
+    bool isEmpty() const noexcept                       { return ranges.empty(); }
+    bool contains (te::TimePosition) const;
+
+    /** The ranges in timeline order; none of them overlap or touch. */
+    const std::vector<te::TimeRange>& getRanges() const noexcept     { return ranges; }
+
+    te::TimeDuration getTotalLength() const;
+    te::TimeRange getBounds() const;
+
+private:
+    std::vector<te::TimeRange> ranges;
+};
@@ -0,0 +1,129 @@
+#include "SharedClipboard.h"
+
+SharedClipboard::SharedClipboard (const juce::String& name)
+    : file (juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile (name + ".clipboard")),
+      lock (name + "Clipboard")
+{
+    const juce::InterProcessLock::ScopedLockType sl (lock);
+
+    if (! sl.isLocked() || ! map())
+        DBG ("Shared clipboard unavailable: " + file.getFullPathName());
+}
+
+SharedClipboard::~SharedClipboard() = default;
+
+SharedClipboard::Header* SharedClipboard::getHeader() const noexcept
+{
+    return mappedFile != nullptr ? static_cast<Header*> (mappedFile->getData()) : nullptr;
+}
+
+bool SharedClipboard::map()
+{
+    // The first instance to get here sizes the file; mapping it shares the pages between processes.
+    if (file.getSize() < (juce::int64) capacity)
+    {
+        juce::FileOutputStream out (file);
+        if (! out.openedOk() || ! out.setPosition ((juce::int64) capacity - 1) || ! out.writeByte (0))
+            return false;
+    }
+
+    mappedFile = std::make_unique<juce::MemoryMappedFile> (file, juce::Range<juce::int64> (0, (juce::int64) capacity),
+                                                           juce::MemoryMappedFile::readWrite, false);
+
+    if (mappedFile->getData() == nullptr || mappedFile->getSize() < capacity)
+    {
+        mappedFile.reset();
+        return false;
+    }
+
+    auto* header = getHeader();
+
+    if (header->magic != magic || header->version != formatVersion)
+        *header = { magic, formatVersion, 0, 0 };
+
+    lastSequence = getSequence (*header).load();
+    return true;
+}
+
+bool SharedClipboard::publish (const std::vector<Fragment>& fragments)
+{
+    payload.reset();
+    payload.writeInt ((int) fragments.size());
+
+    for (auto& fragment : fragments)
+    {
+        payload.writeDouble (fragment.relativeStart);
+        payload.writeDouble (fragment.length);
+        payload.writeDouble (fragment.sourceOffset);
+        payload.writeString (fragment.source.getFullPathName());
+    }
+
+    const juce::InterProcessLock::ScopedLockType sl (lock);
+
+    auto* header = getHeader();
+
+    if (! sl.isLocked() || header == nullptr || payload.getDataSize() > capacity - sizeof (Header))
+        return false;
+
+    std::memcpy (header + 1, payload.getData(), payload.getDataSize());
+    header->numBytes = payload.getDataSize();
+    lastSequence = getSequence (*header).load() + 1;
+    getSequence (*header).store (lastSequence);
+    return true;
+}
+
+std::optional<std::vector<SharedClipboard::Fragment>> SharedClipboard::fetchIfChanged()
+{
+    if (! hasChanged())
+        return std::nullopt;
+
+    juce::MemoryBlock data;
+
+    {
+        const juce::InterProcessLock::ScopedLockType sl (lock);
+
+        auto* header = getHeader();
+
+        if (! sl.isLocked() || header == nullptr || getSequence (*header).load() == lastSequence || header->numBytes > capacity - sizeof (Header))
+            return std::nullopt;
+
+        data.append (header + 1, (size_t) header->numBytes);
+        lastSequence = getSequence (*header).load();
+    }
+
+    // The file is in the shared temp folder, so its contents are checked rather than trusted.
+    juce::MemoryInputStream in (data, false);
+    const auto numFragments = in.readInt();
+
+    if (numFragments < 0 || (size_t) numFragments > data.getSize() / minimumFragmentSize)
+        return std::nullopt;
+
+    std::vector<Fragment> fragments ((size_t) numFragments);
+
+    for (auto& fragment : fragments)
+    {
+        if (in.isExhausted())
+            return std::nullopt;
+
+        fragment.relativeStart = in.readDouble();
+        fragment.length = in.readDouble();
+        fragment.sourceOffset = in.readDouble();
+
+        const auto path = in.readString();
+        fragment.source = path.isNotEmpty() ? juce::File (path) : juce::File();
+    }
+
+    return fragments;
+}
+
+bool SharedClipboard::hasChanged() const
+{
+    // Checked without the lock (taking it allocates), so polling and pasting locally stay cheap.
+    auto* header = getHeader();
+    return header != nullptr && getSequence (*header).load() != lastSequence;
+}
+
+std::atomic_ref<juce::uint64> SharedClipboard::getSequence (Header& header) noexcept
+{
+    return std::atomic_ref<juce::uint64> (header.sequence);
+}
@@ -0,0 +1,66 @@
+/*
+    Clipboard shared by every editor instance on the machine.
+
+    A copy publishes the clipboard's fragments (source file, offset and length) to a small
+    memory-mapped file guarded by an inter-process lock, with a sequence number that every
+    publish increments. Another instance sees the new sequence number on paste and takes the
+    fragments over. Only references to the sources change hands, never audio data, so a paste
+    costs the same as a local one however much audio it covers.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <optional>
+#include <vector>
+
+class SharedClipboard
+{
+public:
+    struct Fragment
+    {
+        double relativeStart = 0.0, length = 0.0, sourceOffset = 0.0;
+        juce::File source;                  // empty for silence
+    };
+
+    explicit SharedClipboard (const juce::String& name);
+    ~SharedClipboard();
+
+    /** Replaces the shared contents. Returns false if the clipboard couldn't be written,
+        in which case other instances keep seeing the previous contents.
+    */
+    bool publish (const std::vector<Fragment>&);
+
+    /** Returns the shared contents if another instance has published since this one last
+        published or fetched.
+    */
+    std::optional<std::vector<Fragment>> fetchIfChanged();
+
+    bool hasChanged() const;
+
+private:
+    static constexpr juce::uint32 magic = 0x54454342;  // "TECB"
+    static constexpr juce::uint32 formatVersion = 1;
+    static constexpr size_t capacity = 4 * 1024 * 1024;
+    static constexpr size_t minimumFragmentSize = 3 * sizeof (double) + 1;    // three doubles and an empty path
+
+    struct Header
+    {
+        juce::uint32 magic, version;
+        alignas (8) juce::uint64 sequence;     // read without the lock, so always accessed atomically
+        juce::uint64 numBytes;
+    };
+
+    Header* getHeader() const noexcept;
+    static std::atomic_ref<juce::uint64> getSequence (Header&) noexcept;
+    bool map();
+
+    const juce::File file;
+    mutable juce::InterProcessLock lock;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    juce::uint64 lastSequence = 0;
+    juce::MemoryOutputStream payload;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedClipboard)
+};
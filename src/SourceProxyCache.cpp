@@ -0,0 +1,185 @@
+#include "SourceProxyCache.h"
+
+SourceProxyCache::SourceProxyCache (const juce::File& cacheDirectory, juce::int64 maxSizeBytes, juce::AudioFormatManager& formats)
+    : juce::Thread ("Proxy decode"),
+      cache (cacheDirectory, maxSizeBytes),
+      formatManager (formats)
+{
+}
+
+SourceProxyCache::~SourceProxyCache()
+{
+    stopThread (10000);
+}
+
+bool SourceProxyCache::needsProxy (const juce::File& source)
+{
+    // Uncompressed files already seek in constant time.
+    return source.existsAsFile()
+        && ! source.hasFileExtension ("wav;wave;bwf;aif;aiff;w64;tedl");
+}
+
+juce::String SourceProxyCache::createKey (const juce::File& source)
+{
+    return RenderCache::createKey ("proxy|" + RenderCache::describeFile (source));
+}
+
+void SourceProxyCache::request (const juce::File& source, std::function<void (const juce::File&)> onReady)
+{
+    if (! needsProxy (source) || cache.lookup (createKey (source), ".wav").existsAsFile())
+        return;
+
+    {
+        const juce::ScopedLock sl (queueLock);
+
+        // A source that is already queued (e.g. by prefetching) keeps its place; a caller
+        // that wants to hear about it takes over the callback.
+        if (source == currentSource)
+        {
+            if (onReady != nullptr)
+                currentOnReady = std::move (onReady);
+
+            return;
+        }
+
+        auto pending = std::find_if (queue.begin(), queue.end(), [&] (const Pending& p) { return p.source == source; });
+
+        if (pending != queue.end())
+        {
+            if (onReady != nullptr)
+                pending->onReady = std::move (onReady);
+
+            return;
+        }
+
+        queue.push_back ({ source, std::move (onReady) });
+    }
+
+    if (isThreadRunning())
+        notify();
+    else
+        startThread (juce::Thread::Priority::low);
+}
+
+juce::File SourceProxyCache::resolve (const juce::File& source)
+{
+    if (! needsProxy (source))
+        return source;
+
+    // Edit list names include the proxy's modification time, so looking it up mustn't touch
+    // it. Proxies in use are pinned instead of being kept recent.
+    auto proxy = cache.lookup (createKey (source), ".wav");
+    return proxy.existsAsFile() ? proxy : source;
+}
+
+void SourceProxyCache::setInUse (const juce::Array<juce::File>& sources)
+{
+    juce::Array<juce::File> proxies;
+
+    for (auto& source : sources)
+        if (needsProxy (source))
+            proxies.add (cache.getFileForKey (createKey (source), ".wav"));
+
+    cache.setPinned (proxies);
+}
+
+bool SourceProxyCache::isDecoding() const
+{
+    const juce::ScopedLock sl (queueLock);
+    return currentSource != juce::File() || ! queue.empty();
+}
+
+void SourceProxyCache::run()
+{
+    while (! threadShouldExit())
+    {
+        Pending next;
+
+        {
+            const juce::ScopedLock sl (queueLock);
+
+            if (! queue.empty())
+            {
+                next = std::move (queue.front());
+                queue.pop_front();
+            }
+
+            currentSource = next.source;
+            currentOnReady = std::move (next.onReady);
+        }
+
+        if (next.source == juce::File())
+        {
+            wait (-1);
+            continue;
+        }
+
+        const auto key = createKey (next.source);
+        const auto part = cache.getFileForKey (key, ".part");
+        const auto proxy = cache.getFileForKey (key, ".wav");
+
+        // Written under a temporary name so a half-decoded proxy is never picked up.
+        bool ready = decode (next.source, part) && part.moveFileTo (proxy);
+
+        if (ready)
+            cache.commit (proxy);
+        else
+            part.deleteFile();
+
+        {
+            const juce::ScopedLock sl (queueLock);
+            currentSource = juce::File();
+            next.onReady = std::move (currentOnReady);
+        }
+
+        DBG ("Proxy for " << next.source.getFileName() << (ready ? " ready" : " failed"));
+
+        if (ready && next.onReady != nullptr)
+        {
+            juce::MessageManager::callAsync ([weakThis = juce::WeakReference<SourceProxyCache> (this), next]
+            {
+                if (weakThis != nullptr)
+                    next.onReady (next.source);
+            });
+        }
+    }
+}
+
+bool SourceProxyCache::decode (const juce::File& source, const juce::File& dest)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (source));
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+        return false;
+
+    dest.getParentDirectory().createDirectory();
+    dest.deleteFile();
+
+    auto out = dest.createOutputStream();
+    if (out == nullptr)
+        return false;
+
+    // Float keeps the decoder output exactly and can be memory-mapped for reading.
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (out.get(), reader->sampleRate,
+                                                                          reader->numChannels, 32, {}, 0));
+    if (writer == nullptr)
+        return false;
+
+    out.release();
+
+    juce::AudioBuffer<float> buffer ((int) reader->numChannels, blockSize);
+
+    for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += blockSize)
+    {
+        if (threadShouldExit())
+            return false;
+
+        const auto numThisTime = (int) std::min<juce::int64> (blockSize, reader->lengthInSamples - pos);
+
+        if (! reader->read (&buffer, 0, numThisTime, pos, true, true)
+             || ! writer->writeFromAudioSampleBuffer (buffer, 0, numThisTime))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+    Uncompressed proxies for compressed sources.
+
+    MP3, Ogg, FLAC and similar sources are slow to seek, and playback seeks at every
+    segment boundary. Such sources are decoded once, on a background thread, to a float
+    WAV kept in a RenderCache, and edit lists refer to the proxy instead of the original
+    once it exists. Proxies are keyed by the source's path, size and modification time,
+    so they are reused across sessions until the source changes.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "RenderCache.h"
+#include <deque>
+#include <functional>
+
+class SourceProxyCache : private juce::Thread
+{
+public:
+    SourceProxyCache (const juce::File& cacheDirectory, juce::int64 maxSizeBytes, juce::AudioFormatManager& formats);
+    ~SourceProxyCache() override;
+
+    /** True for sources that are worth decoding to a proxy. */
+    static bool needsProxy (const juce::File& source);
+
+    /** Queues a background decode of source if it needs one and no proxy exists yet.
+        onReady is called on the message thread with the source once its proxy is ready.
+    */
+    void request (const juce::File& source, std::function<void (const juce::File& source)> onReady);
+
+    /** Returns the file playback should read for source: its proxy if one is ready,
+        otherwise the source itself.
+    */
+    juce::File resolve (const juce::File& source);
+
+    /** Keeps the proxies of these sources from being evicted while edit lists read them. */
+    void setInUse (const juce::Array<juce::File>& sources);
+
+    bool isDecoding() const;
+
+private:
+    static constexpr int blockSize = 65536;
+
+    static juce::String createKey (const juce::File& source);
+    void run() override;
+    bool decode (const juce::File& source, const juce::File& dest);
+
+    RenderCache cache;
+    juce::AudioFormatManager& formatManager;
+
+    struct Pending
+    {
+        juce::File source;
+        std::function<void (const juce::File&)> onReady;
+    };
+
+    juce::CriticalSection queueLock;
+    std::deque<Pending> queue;
+    juce::File currentSource;
+    std::function<void (const juce::File&)> currentOnReady;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (SourceProxyCache)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SourceProxyCache)
+};
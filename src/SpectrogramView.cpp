@@ -0,0 +1,343 @@
+#include "SpectrogramView.h"
+#include <cmath>
+
+namespace
+{
+    juce::Colour colourForLevel (float level)
+    {
+        level = juce::jlimit (0.0f, 1.0f, level);
+        return juce::Colour::fromHSV (0.7f - 0.6f * level, 0.9f, level, 1.0f);
+    }
+}
+
+class SpectrogramTileCache::TileJob : public juce::ThreadPoolJob
+{
+public:
+    // The source is copied in, so setSource() can move on without waiting for running jobs.
+    TileJob (SpectrogramTileCache& ownerRef, TileKey keyToCompute, int requestedGeneration)
+        : juce::ThreadPoolJob ("Spectrogram tile"),
+          owner (ownerRef), key (keyToCompute),
+          source (ownerRef.source),
+          storeKey (RenderCache::createKey (ownerRef.sourceKey + "|" + juce::String (keyToCompute.first) + "|" + juce::String (keyToCompute.second))),
+          requestGeneration (requestedGeneration), sourceGeneration (ownerRef.sourceGeneration.load())
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        // The view has moved on since this tile was requested; let a later paint ask again.
+        if (owner.generation.load() - requestGeneration > 2)
+        {
+            const juce::ScopedLock sl (owner.lock);
+            owner.pending.erase (key);
+            return jobHasFinished;
+        }
+
+        auto* store = owner.diskCache;
+        auto cached = store != nullptr ? store->find (storeKey, ".png") : juce::File();
+        auto image = cached.existsAsFile() ? juce::ImageFileFormat::loadFrom (cached) : juce::Image();
+
+        if (! image.isValid())
+        {
+            image = owner.computeTile (source, key.first, key.second);
+
+            if (store != nullptr && ! shouldExit() && store->getDirectory().createDirectory())
+                writeToStore (*store, image);
+        }
+
+        owner.addTile (key, image, sourceGeneration);
+        return jobHasFinished;
+    }
+
+private:
+    // Written under a temporary name and renamed, so the store never holds half a PNG.
+    void writeToStore (RenderCache& store, const juce::Image& image) const
+    {
+        const auto part = store.getFileForKey (storeKey, ".part");
+        const auto dest = store.getFileForKey (storeKey, ".png");
+        part.deleteFile();
+        bool written = false;
+
+        {
+            juce::FileOutputStream out (part);
+            juce::PNGImageFormat png;
+            written = out.openedOk() && png.writeImageToStream (image, out);
+        }
+
+        if (written && part.moveFileTo (dest))
+            store.commit (dest);
+        else
+            part.deleteFile();
+    }
+
+    SpectrogramTileCache& owner;
+    const TileKey key;
+    const juce::File source;
+    const juce::String storeKey;
+    const int requestGeneration, sourceGeneration;
+};
+
+SpectrogramTileCache::SpectrogramTileCache (juce::AudioFormatManager& formats, size_t maxTilesInMemory, RenderCache* diskCacheToUse)
+    : formatManager (formats),
+      maxTiles (maxTilesInMemory),
+      diskCache (diskCacheToUse),
+      pool (juce::jmax (1, juce::SystemStats::getNumCpus() - 1))
+{
+    // Rows are spaced logarithmically in frequency, which suits speech far better than linear bins.
+    const auto numBins = fftSize / 2;
+    rowToBin.resize (tileHeight + 1);
+
+    for (int row = 0; row <= tileHeight; ++row)
+        rowToBin[(size_t) row] = juce::jlimit (1, numBins, (int) std::round (std::pow ((double) numBins, (double) row / tileHeight)));
+
+    for (size_t row = 1; row < rowToBin.size(); ++row)
+        rowToBin[row] = std::max (rowToBin[row], rowToBin[row - 1] + 1);
+}
+
+SpectrogramTileCache::~SpectrogramTileCache()
+{
+    pool.removeAllJobs (true, 5000);
+}
+
+void SpectrogramTileCache::setSource (const juce::File& sourceFile)
+{
+    // Queued jobs are dropped and running ones asked to stop; whatever they still deliver
+    // carries the old source generation and is ignored by addTile().
+    pool.removeAllJobs (true, 0);
+
+    const juce::ScopedLock sl (lock);
+    ++sourceGeneration;
+    tiles.clear();
+    lru.clear();
+    pending.clear();
+
+    source = sourceFile;
+    sourceKey = RenderCache::createKey (RenderCache::describeFile (source));
+    sampleRate = 0.0;
+    sourceLength = 0;
+
+    if (source.existsAsFile())
+    {
+        if (std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (source)); reader != nullptr)
+        {
+            sampleRate = reader->sampleRate;
+            sourceLength = reader->lengthInSamples;
+        }
+    }
+}
+
+int SpectrogramTileCache::getLevelForSamplesPerPixel (double samplesPerPixel)
+{
+    if (samplesPerPixel <= 1.0)
+        return minLevel;
+
+    return juce::jlimit (minLevel, maxLevel, (int) std::round (std::log2 (samplesPerPixel)));
+}
+
+juce::Image SpectrogramTileCache::getTile (int level, juce::int64 tileIndex, bool scheduleIfMissing)
+{
+    if (tileIndex < 0 || tileIndex * tileColumns * ((juce::int64) 1 << level) >= sourceLength)
+        return {};
+
+    const TileKey key { level, tileIndex };
+    const juce::ScopedLock sl (lock);
+
+    if (auto found = tiles.find (key); found != tiles.end())
+    {
+        lru.splice (lru.begin(), lru, found->second.second);
+        return found->second.first;
+    }
+
+    if (scheduleIfMissing && pending.insert (key).second)
+        pool.addJob (new TileJob (*this, key, generation.load()), true);
+
+    return {};
+}
+
+void SpectrogramTileCache::addTile (TileKey key, const juce::Image& image, int tileSourceGeneration)
+{
+    {
+        const juce::ScopedLock sl (lock);
+
+        // A tile of a previous source; the pending entry for this key, if any, is a new request.
+        if (tileSourceGeneration != sourceGeneration.load())
+            return;
+
+        pending.erase (key);
+
+        if (! image.isValid())
+            return;
+
+        lru.push_front (key);
+        tiles[key] = { image, lru.begin() };
+
+        while (tiles.size() > maxTiles)
+        {
+            tiles.erase (lru.back());
+            lru.pop_back();
+        }
+    }
+
+    if (onTileReady != nullptr)
+        onTileReady();
+}
+
+juce::Image SpectrogramTileCache::computeTile (const juce::File& sourceFile, int level, juce::int64 tileIndex) const
+{
+    juce::Image image (juce::Image::RGB, tileColumns, tileHeight, true, juce::SoftwareImageType());
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (sourceFile));
+    if (reader == nullptr)
+        return image;
+
+    // juce::dsp::FFT uses the platform's vectorised FFT (vDSP, IPP or FFTW) where one is available.
+    juce::dsp::FFT fft (fftOrder);
+    juce::dsp::WindowingFunction<float> window ((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    juce::AudioBuffer<float> block ((int) reader->numChannels, fftSize);
+    juce::HeapBlock<float> fftData ((size_t) fftSize * 2);
+
+    const auto hop = (juce::int64) 1 << level;
+    const auto numChannels = block.getNumChannels();
+    const auto fullScale = (float) fftSize / 4.0f;
+
+    juce::Image::BitmapData pixels (image, juce::Image::BitmapData::writeOnly);
+
+    for (int col = 0; col < tileColumns; ++col)
+    {
+        const auto centre = (tileIndex * tileColumns + col) * hop;
+        if (centre >= reader->lengthInSamples)
+            break;
+
+        reader->read (&block, 0, fftSize, centre - fftSize / 2, true, true);
+
+        juce::FloatVectorOperations::clear (fftData.get(), fftSize * 2);
+        for (int ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::addWithMultiply (fftData.get(), block.getReadPointer (ch), 1.0f / (float) numChannels, fftSize);
+
+        window.multiplyWithWindowingTable (fftData.get(), (size_t) fftSize);
+        fft.performFrequencyOnlyForwardTransform (fftData.get());
+
+        for (int row = 0; row < tileHeight; ++row)
+        {
+            float magnitude = 0.0f;
+            for (auto bin = rowToBin[(size_t) row]; bin < rowToBin[(size_t) row + 1] && bin <= fftSize / 2; ++bin)
+                magnitude = std::max (magnitude, fftData[bin]);
+
+            const auto db = juce::Decibels::gainToDecibels (magnitude / fullScale, -100.0f);
+            pixels.setPixelColour (col, tileHeight - 1 - row, colourForLevel (juce::jmap (db, -100.0f, 0.0f, 0.0f, 1.0f)));
+        }
+    }
+
+    return image;
+}
+
+SpectrogramView::SpectrogramView (IAudioEngine& engineInterface)
+    : audioEngine (engineInterface),
+      tileStore (engineInterface.getEngine().getPropertyStorage().getAppCacheFolder().getChildFile ("SpectrogramTiles"),
+                 (juce::int64) 256 * 1024 * 1024),
+      tileCache (engineInterface.getEngine().getAudioFileFormatManager().readFormatManager, 512, &tileStore)
+{
+    setOpaque (true);
+    tileCache.onTileReady = [this] { triggerAsyncUpdate(); };
+
+    // The source is picked up here rather than in paint(), which must never wait on the tile workers.
+    timerCallback();
+    startTimer (250);
+}
+
+SpectrogramView::~SpectrogramView()
+{
+    stopTimer();
+    cancelPendingUpdate();
+}
+
+void SpectrogramView::setViewRange (te::TimeRange newRange)
+{
+    if (newRange != viewRange)
+    {
+        viewRange = newRange;
+        repaint();
+    }
+}
+
+void SpectrogramView::handleAsyncUpdate()
+{
+    repaint();
+}
+
+void SpectrogramView::timerCallback()
+{
+    if (auto sourceFile = audioEngine.getSourceFile(); sourceFile != tileCache.getSource())
+    {
+        tileCache.setSource (sourceFile);
+        repaint();
+    }
+}
+
+void SpectrogramView::paint (juce::Graphics& g)
+{
+    g.fillAll (juce::Colours::black);
+
+    if (tileCache.getSampleRate() <= 0.0 || viewRange.isEmpty() || getWidth() <= 0)
+        return;
+
+    tileCache.beginRequests();
+
+    const auto samplesPerPixel = viewRange.getLength().inSeconds() * tileCache.getSampleRate() / getWidth();
+    const auto level = SpectrogramTileCache::getLevelForSamplesPerPixel (samplesPerPixel);
+
+    // Coarser tiles stand in while the ones for this zoom level are still being computed.
+    for (int coarser = std::min (level + 2, SpectrogramTileCache::maxLevel); coarser > level; --coarser)
+        drawLevel (g, coarser, false);
+
+    drawLevel (g, level, true);
+}
+
+void SpectrogramView::drawLevel (juce::Graphics& g, int level, bool scheduleMissing)
+{
+    constexpr auto tileColumns = SpectrogramTileCache::tileColumns;
+    const auto sampleRate = tileCache.getSampleRate();
+    const auto hop = (double) ((juce::int64) 1 << level);
+    const auto viewStart = viewRange.getStart().inSeconds();
+    const auto viewEnd = viewRange.getEnd().inSeconds();
+    const auto pixelsPerSecond = getWidth() / viewRange.getLength().inSeconds();
+
+    double segStart = 0.0;
+
+    // Consolidated runs are drawn from the tiles of the source they were rendered from.
+    for (auto& seg : audioEngine.getSourceSegments())
+    {
+        const auto segLength = seg.length.inSeconds();
+        const auto visibleStart = std::max (segStart, viewStart);
+        const auto visibleEnd = std::min (segStart + segLength, viewEnd);
+
+        // Tiles only cover the loaded file; other sources (recorded takes) are left blank.
+        if (visibleEnd > visibleStart && seg.source == tileCache.getSource())
+        {
+            const auto colStart = (seg.sourceOffset.inSeconds() + (visibleStart - segStart)) * sampleRate / hop;
+            const auto colEnd = colStart + (visibleEnd - visibleStart) * sampleRate / hop;
+            const auto x0 = (visibleStart - viewStart) * pixelsPerSecond;
+            const auto pixelsPerColumn = (visibleEnd - visibleStart) * pixelsPerSecond / (colEnd - colStart);
+
+            for (auto tile = (juce::int64) std::floor (colStart / tileColumns); (double) (tile * tileColumns) < colEnd; ++tile)
+            {
+                auto image = tileCache.getTile (level, tile, scheduleMissing);
+                if (! image.isValid())
+                    continue;
+
+                const auto firstCol = std::max (colStart, (double) (tile * tileColumns));
+                const auto lastCol = std::min (colEnd, (double) ((tile + 1) * tileColumns));
+                const auto destX = juce::roundToInt (x0 + (firstCol - colStart) * pixelsPerColumn);
+                const auto destRight = juce::roundToInt (x0 + (lastCol - colStart) * pixelsPerColumn);
+                const auto srcX = (int) (firstCol - (double) (tile * tileColumns));
+
+                g.drawImage (image, destX, 0, std::max (1, destRight - destX), getHeight(),
+                             srcX, 0, std::max (1, juce::roundToInt (lastCol - firstCol)), SpectrogramTileCache::tileHeight);
+            }
+        }
+
+        segStart += segLength;
+        if (segStart >= viewEnd)
+            break;
+    }
+}
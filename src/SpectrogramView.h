@@ -0,0 +1,107 @@
+/*
+    Spectrogram display for the edited timeline.
+
+    Spectra are computed over the source file in fixed-size tiles, one set of tiles per
+    zoom level (FFT hop of 2^level samples), on a pool of worker threads. Tiles are kept
+    in an LRU cache in memory and optionally as PNGs in a size-bounded RenderCache on disk,
+    and the view composes them
+    through the current segment list the same way the waveform is drawn, so scrolling and
+    zooming only ever blit cached images.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioEngine.h"
+#include "RenderCache.h"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+
+class SpectrogramTileCache
+{
+public:
+    static constexpr int fftOrder = 10;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int tileColumns = 256;
+    static constexpr int tileHeight = 256;
+    static constexpr int minLevel = 6;
+    static constexpr int maxLevel = 20;
+
+    SpectrogramTileCache (juce::AudioFormatManager& formats, size_t maxTilesInMemory, RenderCache* diskCacheToUse = nullptr);
+    ~SpectrogramTileCache();
+
+    /** Switches to another source. Doesn't wait for tiles of the old one still being computed;
+        they're discarded when they finish.
+    */
+    void setSource (const juce::File& sourceFile);
+    const juce::File& getSource() const noexcept          { return source; }
+    double getSampleRate() const noexcept                 { return sampleRate; }
+
+    /** Picks the zoom level whose hop best matches the given number of source samples per pixel. */
+    static int getLevelForSamplesPerPixel (double samplesPerPixel);
+
+    /** Marks the start of a new paint; tiles requested by older paints that haven't started yet are dropped. */
+    void beginRequests()                                  { ++generation; }
+
+    /** Returns a tile if it's ready. Otherwise an invalid image is returned and, if scheduleIfMissing is set,
+        the tile is queued on the worker pool.
+    */
+    juce::Image getTile (int level, juce::int64 tileIndex, bool scheduleIfMissing);
+
+    /** Called from a worker thread whenever a tile finishes. */
+    std::function<void()> onTileReady;
+
+private:
+    using TileKey = std::pair<int, juce::int64>;
+    class TileJob;
+
+    juce::Image computeTile (const juce::File& sourceFile, int level, juce::int64 tileIndex) const;
+    void addTile (TileKey, const juce::Image&, int sourceGeneration);
+
+    juce::AudioFormatManager& formatManager;
+    const size_t maxTiles;
+    RenderCache* const diskCache;
+    juce::File source;
+    juce::String sourceKey;
+    double sampleRate = 0.0;
+    juce::int64 sourceLength = 0;
+    std::vector<int> rowToBin;
+
+    juce::CriticalSection lock;
+    std::list<TileKey> lru;
+    std::map<TileKey, std::pair<juce::Image, std::list<TileKey>::iterator>> tiles;
+    std::set<TileKey> pending;
+    std::atomic<int> generation { 0 }, sourceGeneration { 0 };
+    juce::ThreadPool pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrogramTileCache)
+};
+
+class SpectrogramView : public juce::Component,
+                        private juce::AsyncUpdater,
+                        private juce::Timer
+{
+public:
+    explicit SpectrogramView (IAudioEngine& engineInterface);
+    ~SpectrogramView() override;
+
+    /** Sets the visible range of the timeline, in the same coordinates as the waveform view. */
+    void setViewRange (te::TimeRange newRange);
+
+    void paint (juce::Graphics& g) override;
+
+private:
+    void handleAsyncUpdate() override;
+    void timerCallback() override;
+    void drawLevel (juce::Graphics& g, int level, bool scheduleMissing);
+
+    IAudioEngine& audioEngine;
+    RenderCache tileStore;
+    SpectrogramTileCache tileCache;
+    te::TimeRange viewRange;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrogramView)
+};
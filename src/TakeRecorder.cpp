@@ -0,0 +1,134 @@
+#include "TakeRecorder.h"
+
+TakeRecorder::TakeRecorder (juce::TimeSliceThread& writerThreadToUse)
+    : writerThread (writerThreadToUse)
+{
+}
+
+TakeRecorder::~TakeRecorder()
+{
+    stop();
+}
+
+bool TakeRecorder::start (const juce::File& takeFile, int numChannels, std::function<double()> playPosition)
+{
+    stop();
+
+    const auto sampleRate = deviceSampleRate.load();
+    if (sampleRate <= 0.0 || numChannels <= 0)
+        return false;
+
+    takeFile.getParentDirectory().createDirectory();
+    takeFile.deleteFile();
+
+    auto out = takeFile.createOutputStream();
+    if (out == nullptr)
+        return false;
+
+    // Takes are kept as float so nothing is quantised before they are edited.
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> fileWriter (wav.createWriterFor (out.get(), sampleRate, (unsigned int) numChannels, 32, {}, 0));
+    if (fileWriter == nullptr)
+        return false;
+
+    out.release();
+
+    // The FIFO is allocated here, so the audio thread only ever copies into it.
+    auto threadedWriter = std::make_unique<juce::AudioFormatWriter::ThreadedWriter> (fileWriter.release(), writerThread,
+                                                                                     (int) sampleRate * fifoSeconds);
+
+    samplesRecorded = 0;
+    samplesDropped = 0;
+    dropouts = 0;
+    startPosition = 0.0;
+    playbackStarted = false;
+
+    {
+        const juce::SpinLock::ScopedLockType sl (writerLock);
+        writer = std::move (threadedWriter);
+        takeChannels = std::min (numChannels, maxChannels);
+        std::swap (getPlayPosition, playPosition);
+    }
+
+    recording = true;
+    return true;
+}
+
+TakeRecorder::Stats TakeRecorder::stop()
+{
+    recording = false;
+
+    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> finished;
+    std::function<double()> finishedPosition;
+
+    {
+        const juce::SpinLock::ScopedLockType sl (writerLock);
+        finished = std::move (writer);
+        std::swap (finishedPosition, getPlayPosition);
+    }
+
+    // Deleting the threaded writer writes out whatever is still in the FIFO and closes the file.
+    finished.reset();
+    return getStats();
+}
+
+TakeRecorder::Stats TakeRecorder::getStats() const noexcept
+{
+    return { samplesRecorded.load(), samplesDropped.load(), dropouts.load(), startPosition.load(), playbackStarted.load() };
+}
+
+void TakeRecorder::audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                                     float* const* outputChannelData, int numOutputChannels,
+                                                     int numSamples, const juce::AudioIODeviceCallbackContext&)
+{
+    for (int ch = 0; ch < numOutputChannels; ++ch)
+        if (outputChannelData[ch] != nullptr)
+            juce::FloatVectorOperations::clear (outputChannelData[ch], numSamples);
+
+    if (! recording.load() || numInputChannels <= 0)
+        return;
+
+    // Only start() and stop() take this lock, so it is practically never contended here.
+    const juce::SpinLock::ScopedTryLockType sl (writerLock);
+    if (! sl.isLocked() || writer == nullptr)
+        return;
+
+    // The transport takes a few blocks to start, so the take is tied to the timeline by the first
+    // block it's seen playing in. What this block captured was played out output latency ago
+    // and reached us input latency later, so it lines up with an earlier point than the playhead.
+    if (! playbackStarted.load() && getPlayPosition != nullptr)
+    {
+        if (const auto position = getPlayPosition(); position >= 0.0)
+        {
+            const auto samplesBefore = samplesRecorded.load();
+            startPosition = position - (double) (samplesBefore + deviceLatencySamples.load()) / deviceSampleRate.load();
+            playbackStarted = true;
+        }
+    }
+
+    const float* channels[maxChannels] = {};
+
+    // The device manager only passes active inputs, so none of these are null.
+    for (int ch = 0; ch < takeChannels; ++ch)
+        channels[ch] = inputChannelData[std::min (ch, numInputChannels - 1)];
+
+    if (writer->write (channels, numSamples))
+    {
+        samplesRecorded += numSamples;
+    }
+    else
+    {
+        samplesDropped += numSamples;
+        ++dropouts;
+    }
+}
+
+void TakeRecorder::audioDeviceAboutToStart (juce::AudioIODevice* device)
+{
+    deviceSampleRate = device != nullptr ? device->getCurrentSampleRate() : 0.0;
+    deviceLatencySamples = device != nullptr ? device->getInputLatencyInSamples() + device->getOutputLatencyInSamples() : 0;
+}
+
+void TakeRecorder::audioDeviceStopped()
+{
+}
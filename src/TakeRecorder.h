@@ -0,0 +1,78 @@
+/*
+    Records input from the audio device into a take file.
+
+    The device callback only pushes samples into the lock-free FIFO of an
+    AudioFormatWriter::ThreadedWriter, whose background thread does the disk writes, so
+    nothing on the audio thread allocates, locks or touches the disk. Everything from the first
+    callback is kept, pre-roll included; the recorder notes where on the timeline the take's
+    first sample belongs, so the caller can place it without trimming the file.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class TakeRecorder : public juce::AudioIODeviceCallback
+{
+public:
+    explicit TakeRecorder (juce::TimeSliceThread& writerThreadToUse);
+    ~TakeRecorder() override;
+
+    struct Stats
+    {
+        juce::int64 samplesRecorded = 0;
+        juce::int64 samplesDropped = 0;     // the FIFO was full when the audio thread tried to write
+        int dropouts = 0;                   // blocks in which some samples were dropped
+
+        /** Timeline position, in seconds, that the take's first sample was played against, with
+            the device's input and output latency taken off. Only valid if playbackStarted.
+        */
+        double startPosition = 0.0;
+        bool playbackStarted = false;
+    };
+
+    /** Starts writing a WAV file with numChannels channels at the device rate. Input channels
+        beyond the device's are filled from the last available one. getPlayPosition is called
+        on the audio thread, so it must not block, until it first returns the transport's
+        position in seconds rather than a negative value meaning it isn't playing yet.
+        Call from the message thread with the device running.
+    */
+    bool start (const juce::File& takeFile, int numChannels, std::function<double()> getPlayPosition);
+
+    /** Stops, flushes the file to disk and returns the final counts. */
+    Stats stop();
+
+    bool isRecording() const noexcept                   { return recording.load(); }
+    double getDeviceSampleRate() const noexcept         { return deviceSampleRate.load(); }
+    Stats getStats() const noexcept;
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                           float* const* outputChannelData, int numOutputChannels,
+                                           int numSamples, const juce::AudioIODeviceCallbackContext&) override;
+    void audioDeviceAboutToStart (juce::AudioIODevice*) override;
+    void audioDeviceStopped() override;
+
+private:
+    static constexpr int fifoSeconds = 4;
+    static constexpr int maxChannels = 8;
+
+    juce::TimeSliceThread& writerThread;
+
+    juce::SpinLock writerLock;
+    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> writer;
+    int takeChannels = 0;
+    std::function<double()> getPlayPosition;        // guarded by writerLock
+
+    std::atomic<bool> recording { false };
+    std::atomic<juce::int64> samplesRecorded { 0 }, samplesDropped { 0 };
+    std::atomic<int> dropouts { 0 };
+    std::atomic<double> startPosition { 0.0 };
+    std::atomic<bool> playbackStarted { false };
+    std::atomic<double> deviceSampleRate { 0.0 };
+    std::atomic<int> deviceLatencySamples { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TakeRecorder)
+};
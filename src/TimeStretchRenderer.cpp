@@ -0,0 +1,222 @@
+#include "TimeStretchRenderer.h"
+
+TimeStretchRenderer::TimeStretchRenderer (juce::AudioFormatManager& formats)
+    : juce::Thread ("Time stretch"),
+      formatManager (formats)
+{
+}
+
+TimeStretchRenderer::~TimeStretchRenderer()
+{
+    stopThread (10000);
+}
+
+bool TimeStretchRenderer::render (const Request& newRequest, std::function<void (bool)> onComplete)
+{
+    if (isThreadRunning() || newRequest.numSamples <= 0 || newRequest.lengthRatio <= 0.0)
+        return false;
+
+    request = newRequest;
+    onRenderComplete = std::move (onComplete);
+    progress = 0.0f;
+    samplesDone = 0;
+    startThread();
+    return true;
+}
+
+bool TimeStretchRenderer::renderChunk (juce::AudioFormatReader& reader, juce::int64 chunkStart, juce::int64 chunkEnd,
+                                       juce::AudioBuffer<float>& result)
+{
+    const auto numChannels = (int) reader.numChannels;
+    const auto selectionEnd = request.startSample + request.numSamples;
+    const auto context = (juce::int64) (contextSeconds * reader.sampleRate);
+    const auto readStart = std::max (request.startSample, chunkStart - context);
+    const auto readEnd = std::min (selectionEnd, chunkEnd + context);
+
+    te::TimeStretcher stretcher;
+    if (! stretcher.initialise (reader.sampleRate, blockSize, numChannels, te::TimeStretcher::soundtouchBetter, {}, false))
+        return false;
+
+    stretcher.setSpeedAndPitch ((float) (1.0 / request.lengthRatio), request.semitones);
+
+    // Output before skip comes from the leading context; everything after chunkEnd except
+    // the crossfade overlap belongs to the next chunk.
+    const auto skip = (juce::int64) std::llround ((double) (chunkStart - readStart) * request.lengthRatio);
+    const auto keep = (juce::int64) std::llround ((double) (chunkEnd - chunkStart) * request.lengthRatio)
+                        + (chunkEnd < selectionEnd ? crossfadeSamples : 0);
+
+    result.setSize (numChannels, (int) keep);
+    result.clear();
+
+    juce::AudioBuffer<float> in (numChannels, std::max (blockSize, stretcher.getMaxFramesNeeded()));
+    juce::AudioBuffer<float> out (numChannels, blockSize);
+    juce::int64 readPos = readStart, produced = 0;
+
+    auto append = [&] (int numProduced)
+    {
+        const auto from = std::max (produced, skip);
+        const auto to = std::min (produced + numProduced, skip + keep);
+
+        if (to > from)
+            for (int ch = 0; ch < numChannels; ++ch)
+                result.copyFrom (ch, (int) (from - skip), out, ch, (int) (from - produced), (int) (to - from));
+
+        produced += numProduced;
+    };
+
+    while (produced < skip + keep && ! threadShouldExit())
+    {
+        if (readPos >= readEnd)
+        {
+            const auto numFlushed = stretcher.flush (out.getArrayOfWritePointers());
+            if (numFlushed <= 0)
+                break;
+
+            append (numFlushed);
+            continue;
+        }
+
+        const auto numToRead = (int) std::min<juce::int64> (std::max (1, stretcher.getFramesNeeded()), readEnd - readPos);
+        reader.read (&in, 0, numToRead, readPos, true, true);
+        append (stretcher.processData (in.getArrayOfReadPointers(), numToRead, out.getArrayOfWritePointers()));
+
+        readPos += numToRead;
+        samplesDone += numToRead;
+        progress = 0.9f * (float) samplesDone.load() / (float) request.numSamples;
+    }
+
+    return ! threadShouldExit();
+}
+
+void TimeStretchRenderer::run()
+{
+    bool succeeded = false;
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (request.timeline));
+
+    if (reader != nullptr)
+    {
+        const auto numChannels = (int) reader->numChannels;
+        const auto chunkLength = (juce::int64) (chunkSeconds * reader->sampleRate);
+        const auto selectionEnd = request.startSample + request.numSamples;
+
+        std::vector<std::pair<juce::int64, juce::int64>> chunks;
+        for (auto start = request.startSample; start < selectionEnd; start += chunkLength)
+            chunks.push_back ({ start, std::min (selectionEnd, start + chunkLength) });
+
+        std::vector<juce::AudioBuffer<float>> results (chunks.size());
+        std::atomic<bool> failed { false };
+
+        // Each worker gets its own reader, all opened before any chunk starts: a rebuild while
+        // the stretch runs may delete the timeline file, and readers that are already open
+        // have every source open too.
+        const auto numWorkers = juce::jlimit (1, juce::jmax (1, (int) chunks.size()), juce::SystemStats::getNumCpus());
+        std::vector<std::unique_ptr<juce::AudioFormatReader>> workerReaders;
+        std::vector<juce::AudioFormatReader*> idleReaders;
+        juce::CriticalSection idleLock;
+
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            workerReaders.emplace_back (formatManager.createReaderFor (request.timeline));
+
+            if (workerReaders.back() == nullptr)
+                failed = true;
+            else
+                idleReaders.push_back (workerReaders.back().get());
+        }
+
+        {
+            juce::ThreadPool pool (numWorkers);
+
+            for (size_t i = 0; i < chunks.size() && ! failed; ++i)
+            {
+                pool.addJob ([this, &chunks, &results, &failed, &idleReaders, &idleLock, i]
+                {
+                    juce::AudioFormatReader* chunkReader = nullptr;
+
+                    {
+                        const juce::ScopedLock sl (idleLock);
+                        chunkReader = idleReaders.back();
+                        idleReaders.pop_back();
+                    }
+
+                    if (! failed && ! renderChunk (*chunkReader, chunks[i].first, chunks[i].second, results[i]))
+                        failed = true;
+
+                    const juce::ScopedLock sl (idleLock);
+                    idleReaders.push_back (chunkReader);
+                });
+            }
+
+            while (pool.getNumJobs() > 0 && ! threadShouldExit())
+                wait (50);
+
+            pool.removeAllJobs (true, 10000);
+        }
+
+        if (threadShouldExit())
+            return;
+
+        // Written under a temporary name so an interrupted render is never mistaken for a cached one.
+        auto partFile = request.destFile.getSiblingFile (request.destFile.getFileName() + ".part");
+        partFile.getParentDirectory().createDirectory();
+        partFile.deleteFile();
+
+        if (! failed)
+        {
+            juce::WavAudioFormat wav;
+            auto out = partFile.createOutputStream();
+            std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? wav.createWriterFor (out.get(), reader->sampleRate, (unsigned int) numChannels,
+                                                                                                  32, {}, 0)
+                                                                             : nullptr);
+
+            if (writer != nullptr)
+            {
+                out.release();
+                succeeded = true;
+                juce::AudioBuffer<float> tail;
+
+                for (size_t i = 0; i < results.size() && succeeded; ++i)
+                {
+                    auto& buffer = results[i];
+                    const bool isLast = i + 1 == results.size();
+
+                    if (tail.getNumSamples() > 0)
+                    {
+                        const auto numToFade = std::min (tail.getNumSamples(), buffer.getNumSamples());
+
+                        for (int ch = 0; ch < numChannels; ++ch)
+                        {
+                            buffer.applyGainRamp (ch, 0, numToFade, 0.0f, 1.0f);
+                            buffer.addFromWithRamp (ch, 0, tail.getReadPointer (ch), numToFade, 1.0f, 0.0f);
+                        }
+                    }
+
+                    const auto body = isLast ? buffer.getNumSamples() : std::max (0, buffer.getNumSamples() - crossfadeSamples);
+                    succeeded = writer->writeFromAudioSampleBuffer (buffer, 0, body);
+
+                    if (! isLast)
+                    {
+                        tail.setSize (numChannels, buffer.getNumSamples() - body);
+                        for (int ch = 0; ch < numChannels; ++ch)
+                            tail.copyFrom (ch, 0, buffer, ch, body, tail.getNumSamples());
+                    }
+
+                    buffer.setSize (0, 0);
+                    progress = 0.9f + 0.1f * (float) (i + 1) / (float) results.size();
+                }
+            }
+        }
+
+        succeeded = succeeded && partFile.moveFileTo (request.destFile);
+
+        if (! succeeded)
+            partFile.deleteFile();
+    }
+
+    juce::MessageManager::callAsync ([weakThis = juce::WeakReference<TimeStretchRenderer> (this), succeeded]
+    {
+        if (weakThis != nullptr && weakThis->onRenderComplete != nullptr)
+            weakThis->onRenderComplete (succeeded);
+    });
+}
@@ -0,0 +1,60 @@
+/*
+    Offline time-stretch and pitch-shift of a stretch of the timeline.
+
+    The input is cut into chunks that are stretched on a pool of worker threads, each with
+    its own stretcher and some context either side so it settles before the part that is
+    kept. Neighbouring chunks are joined with a short crossfade and the result is written
+    to a float WAV, which then becomes an ordinary source for the segment list, so the
+    stretcher never runs during playback.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <tracktion_engine/tracktion_engine.h>
+#include <atomic>
+#include <functional>
+
+namespace te = tracktion;
+
+class TimeStretchRenderer : private juce::Thread
+{
+public:
+    struct Request
+    {
+        juce::File timeline;                // any file readable by the format manager, e.g. an edit list
+        juce::int64 startSample = 0, numSamples = 0;
+        double lengthRatio = 1.0;           // output length / input length
+        float semitones = 0.0f;
+        juce::File destFile;
+    };
+
+    explicit TimeStretchRenderer (juce::AudioFormatManager& formats);
+    ~TimeStretchRenderer() override;
+
+    /** Starts rendering in the background; returns false if a render is already running.
+        onComplete is called on the message thread.
+    */
+    bool render (const Request&, std::function<void (bool succeeded)> onComplete);
+
+    bool isRendering() const            { return isThreadRunning(); }
+    float getProgress() const           { return progress.load(); }
+
+private:
+    static constexpr int chunkSeconds = 10;
+    static constexpr int contextSeconds = 1;
+    static constexpr int crossfadeSamples = 2048;
+    static constexpr int blockSize = 1024;
+
+    void run() override;
+    bool renderChunk (juce::AudioFormatReader&, juce::int64 chunkStart, juce::int64 chunkEnd, juce::AudioBuffer<float>& result);
+
+    juce::AudioFormatManager& formatManager;
+    Request request;
+    std::function<void (bool)> onRenderComplete;
+    std::atomic<float> progress { 0.0f };
+    std::atomic<juce::int64> samplesDone { 0 };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (TimeStretchRenderer)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TimeStretchRenderer)
+};
@@ -0,0 +1,464 @@
+#include "Wave64AudioFormat.h"
+#include <array>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    using Guid = std::array<juce::uint8, 16>;
+
+    // GUIDs as stored on disk: the first three fields little-endian, the rest byte-wise.
+    constexpr Guid riffGuid { 0x72, 0x69, 0x66, 0x66, 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00 };
+    constexpr Guid waveGuid { 0x77, 0x61, 0x76, 0x65, 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+    constexpr Guid fmtGuid  { 0x66, 0x6d, 0x74, 0x20, 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+    constexpr Guid dataGuid { 0x64, 0x61, 0x74, 0x61, 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+
+    constexpr juce::int64 chunkHeaderSize = 24;
+    constexpr int formatPcm = 1, formatFloat = 3, formatExtensible = 0xfffe;
+
+    // Reads and writes go through a scratch buffer of at most this many frames, so memory
+    // use is the same whatever the file length.
+    constexpr int maxFramesPerBlock = 8192;
+
+    bool readGuid (juce::InputStream& in, Guid& guid)
+    {
+        return in.read (guid.data(), (int) guid.size()) == (int) guid.size();
+    }
+
+    juce::int64 padToEight (juce::int64 size)
+    {
+        return (size + 7) & ~(juce::int64) 7;
+    }
+
+    // A field of /proc/self/status in kB, e.g. VmRSS or the high-water mark VmHWM; -1 elsewhere.
+    juce::int64 getProcessMemoryKb (const juce::String& field)
+    {
+       #if JUCE_LINUX
+        return juce::File ("/proc/self/status").loadFileAsString()
+                 .fromFirstOccurrenceOf (field + ":", false, false).trim().getLargeIntValue();
+       #else
+        juce::ignoreUnused (field);
+        return -1;
+       #endif
+    }
+
+    void resetPeakMemory()
+    {
+       #if JUCE_LINUX
+        std::ofstream ("/proc/self/clear_refs") << "5";
+       #endif
+    }
+
+    class Wave64Reader : public juce::AudioFormatReader
+    {
+    public:
+        explicit Wave64Reader (juce::InputStream* in)
+            : juce::AudioFormatReader (in, "Wave64")
+        {
+            Guid guid;
+            if (! readGuid (*input, guid) || guid != riffGuid)
+                return;
+
+            input->readInt64();
+
+            if (! readGuid (*input, guid) || guid != waveGuid)
+                return;
+
+            bool foundFormat = false;
+
+            while (! input->isExhausted())
+            {
+                const auto chunkStart = input->getPosition();
+
+                if (! readGuid (*input, guid))
+                    break;
+
+                const auto chunkSize = input->readInt64();
+                if (chunkSize < chunkHeaderSize)
+                    break;
+
+                if (guid == fmtGuid)
+                {
+                    auto format = (int) (juce::uint16) input->readShort();
+                    numChannels = (unsigned int) (juce::uint16) input->readShort();
+                    sampleRate = (double) (juce::uint32) input->readInt();
+                    input->readInt();                                   // bytes per second
+                    bytesPerFrame = (int) (juce::uint16) input->readShort();
+                    bitsPerSample = (unsigned int) (juce::uint16) input->readShort();
+
+                    if (format == formatExtensible && chunkSize >= chunkHeaderSize + 40)
+                    {
+                        input->readShort();                             // extension size
+                        input->readShort();                             // valid bits
+                        input->readInt();                               // channel mask
+                        format = (int) (juce::uint16) input->readShort();  // sub-format GUID starts with the format tag
+                    }
+
+                    usesFloatingPointData = format == formatFloat;
+                    foundFormat = (format == formatPcm || format == formatFloat) && numChannels > 0 && sampleRate > 0.0
+                                    && bytesPerFrame == (int) (numChannels * bitsPerSample / 8);
+                }
+                else if (guid == dataGuid)
+                {
+                    dataStart = chunkStart + chunkHeaderSize;
+                    dataLength = chunkSize - chunkHeaderSize;
+
+                    // A writer that was never closed leaves the size it started with; trust the file length instead.
+                    if (const auto total = input->getTotalLength(); total > 0)
+                        dataLength = std::min (dataLength, total - dataStart);
+                }
+
+                if (dataStart > 0 && foundFormat)
+                    break;
+
+                if (! input->setPosition (chunkStart + padToEight (chunkSize)))
+                    break;
+            }
+
+            if (foundFormat && dataStart > 0 && bytesPerFrame > 0)
+            {
+                lengthInSamples = dataLength / bytesPerFrame;
+                isValid = bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 24
+                            || (bitsPerSample == 32) || (bitsPerSample == 64 && usesFloatingPointData);
+            }
+        }
+
+        bool isValid = false;
+
+        bool readSamples (int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                          juce::int64 startSampleInFile, int numSamples) override
+        {
+            clearSamplesBeyondAvailableLength (destChannels, numDestChannels, startOffsetInDestBuffer,
+                                               startSampleInFile, numSamples, lengthInSamples);
+
+            const auto bytesPerSample = (int) bitsPerSample / 8;
+
+            while (numSamples > 0)
+            {
+                const auto numThisTime = std::min (numSamples, maxFramesPerBlock);
+                const auto numBytes = numThisTime * bytesPerFrame;
+                scratch.ensureSize ((size_t) numBytes);
+
+                input->setPosition (dataStart + startSampleInFile * bytesPerFrame);
+                const auto bytesRead = input->read (scratch.getData(), numBytes);
+
+                if (bytesRead < numBytes)
+                    juce::zeromem (juce::addBytesToPointer (scratch.getData(), bytesRead), (size_t) (numBytes - bytesRead));
+
+                for (int ch = 0; ch < numDestChannels; ++ch)
+                {
+                    auto* dest = destChannels[ch];
+                    if (dest == nullptr)
+                        continue;
+
+                    dest += startOffsetInDestBuffer;
+
+                    if (ch >= (int) numChannels)
+                    {
+                        juce::zeromem (dest, sizeof (int) * (size_t) numThisTime);
+                        continue;
+                    }
+
+                    auto* src = static_cast<const juce::uint8*> (scratch.getData()) + ch * bytesPerSample;
+
+                    for (int i = 0; i < numThisTime; ++i, src += bytesPerFrame)
+                        dest[i] = convertSample (src);
+                }
+
+                startOffsetInDestBuffer += numThisTime;
+                startSampleInFile += numThisTime;
+                numSamples -= numThisTime;
+            }
+
+            return true;
+        }
+
+    private:
+        // Integer samples are returned left-justified in 32 bits and float samples as their
+        // bit pattern, which is what AudioFormatReader expects from readSamples().
+        int convertSample (const juce::uint8* src) const noexcept
+        {
+            if (usesFloatingPointData)
+            {
+                float value = 0.0f;
+
+                if (bitsPerSample == 64)
+                {
+                    double d;
+                    const auto bits = juce::ByteOrder::littleEndianInt64 (src);
+                    std::memcpy (&d, &bits, sizeof (d));
+                    value = (float) d;
+                }
+                else
+                {
+                    const auto bits = juce::ByteOrder::littleEndianInt (src);
+                    std::memcpy (&value, &bits, sizeof (value));
+                }
+
+                int result;
+                std::memcpy (&result, &value, sizeof (result));
+                return result;
+            }
+
+            switch (bitsPerSample)
+            {
+                case 8:     return ((int) src[0] - 128) << 24;
+                case 16:    return (int) juce::ByteOrder::littleEndianShort (src) << 16;
+                case 24:    return (int) (((juce::uint32) src[0] << 8) | ((juce::uint32) src[1] << 16) | ((juce::uint32) src[2] << 24));
+                default:    return (int) juce::ByteOrder::littleEndianInt (src);
+            }
+        }
+
+        juce::int64 dataStart = 0, dataLength = 0;
+        int bytesPerFrame = 0;
+        juce::MemoryBlock scratch;
+    };
+
+    class Wave64Writer : public juce::AudioFormatWriter
+    {
+    public:
+        Wave64Writer (juce::OutputStream* out, double rate, unsigned int channels, int bits)
+            : juce::AudioFormatWriter (out, "Wave64", rate, channels, (unsigned int) bits)
+        {
+            usesFloatingPointData = bits == 32;
+            headerPosition = output->getPosition();
+            writeHeader();
+        }
+
+        ~Wave64Writer() override
+        {
+            if (output == nullptr)
+                return;
+
+            // Chunks are padded to eight bytes; then go back and fill in the real sizes.
+            const auto padding = padToEight (bytesWritten) - bytesWritten;
+            for (juce::int64 i = 0; i < padding; ++i)
+                output->writeByte (0);
+
+            const auto end = output->getPosition();
+
+            if (output->setPosition (headerPosition))
+                writeHeader();
+
+            output->setPosition (end);
+            output->flush();
+        }
+
+        bool write (const int** data, int numSamples) override
+        {
+            const auto bytesPerSample = (int) bitsPerSample / 8;
+            const auto bytesPerFrame = bytesPerSample * (int) numChannels;
+
+            for (int done = 0; done < numSamples;)
+            {
+                const auto numThisTime = std::min (numSamples - done, maxFramesPerBlock);
+                scratch.ensureSize ((size_t) (numThisTime * bytesPerFrame));
+
+                for (int ch = 0; ch < (int) numChannels; ++ch)
+                {
+                    const int* src = data[ch] != nullptr ? data[ch] + done : nullptr;
+                    auto* dest = static_cast<juce::uint8*> (scratch.getData()) + ch * bytesPerSample;
+
+                    for (int i = 0; i < numThisTime; ++i, dest += bytesPerFrame)
+                    {
+                        const auto sample = src != nullptr ? src[i] : 0;
+
+                        if (bitsPerSample == 16)
+                        {
+                            juce::ByteOrder::littleEndian16BitToChars ((juce::int16) (sample >> 16), dest);
+                        }
+                        else if (bitsPerSample == 24)
+                        {
+                            dest[0] = (juce::uint8) (sample >> 8);
+                            dest[1] = (juce::uint8) (sample >> 16);
+                            dest[2] = (juce::uint8) (sample >> 24);
+                        }
+                        else
+                        {
+                            juce::ByteOrder::littleEndian32BitToChars ((juce::uint32) sample, dest);
+                        }
+                    }
+                }
+
+                if (! output->write (scratch.getData(), (size_t) (numThisTime * bytesPerFrame)))
+                    return false;
+
+                bytesWritten += numThisTime * bytesPerFrame;
+                done += numThisTime;
+            }
+
+            return true;
+        }
+
+    private:
+        void writeHeader()
+        {
+            const auto bytesPerFrame = (int) (numChannels * bitsPerSample / 8);
+            const auto fmtChunkSize = chunkHeaderSize + 16;
+            const auto dataChunkSize = chunkHeaderSize + bytesWritten;
+            const auto riffSize = chunkHeaderSize + 16 + padToEight (fmtChunkSize) + padToEight (dataChunkSize);
+
+            output->write (riffGuid.data(), riffGuid.size());
+            output->writeInt64 (riffSize);
+            output->write (waveGuid.data(), waveGuid.size());
+
+            output->write (fmtGuid.data(), fmtGuid.size());
+            output->writeInt64 (fmtChunkSize);
+            output->writeShort ((short) (usesFloatingPointData ? formatFloat : formatPcm));
+            output->writeShort ((short) numChannels);
+            output->writeInt ((int) sampleRate);
+            output->writeInt ((int) sampleRate * bytesPerFrame);
+            output->writeShort ((short) bytesPerFrame);
+            output->writeShort ((short) bitsPerSample);
+
+            output->write (dataGuid.data(), dataGuid.size());
+            output->writeInt64 (dataChunkSize);
+        }
+
+        juce::int64 headerPosition = 0, bytesWritten = 0;
+        juce::MemoryBlock scratch;
+    };
+}
+
+Wave64AudioFormat::Wave64AudioFormat()
+    : juce::AudioFormat ("Wave64 file", juce::StringArray (fileExtension))
+{
+}
+
+juce::Array<int> Wave64AudioFormat::getPossibleSampleRates()
+{
+    return { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000, 352800, 384000 };
+}
+
+juce::AudioFormatReader* Wave64AudioFormat::createReaderFor (juce::InputStream* sourceStream, bool deleteStreamIfOpeningFails)
+{
+    auto reader = std::make_unique<Wave64Reader> (sourceStream);
+
+    if (reader->isValid)
+        return reader.release();
+
+    if (! deleteStreamIfOpeningFails)
+        reader->input = nullptr;
+
+    return nullptr;
+}
+
+juce::AudioFormatWriter* Wave64AudioFormat::createWriterFor (juce::OutputStream* streamToWriteTo, double sampleRateToUse,
+                                                             unsigned int numberOfChannels, int bitsPerSample,
+                                                             const juce::StringPairArray&, int)
+{
+    if (streamToWriteTo == nullptr || numberOfChannels == 0 || ! getPossibleBitDepths().contains (bitsPerSample))
+        return nullptr;
+
+    return new Wave64Writer (streamToWriteTo, sampleRateToUse, numberOfChannels, bitsPerSample);
+}
+
+bool Wave64AudioFormat::runStreamingCheck (const juce::File& directory, juce::String& report)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numChannels = 2, bitsPerSample = 32, blockSize = 65536;
+    constexpr juce::int64 targetBytes = (juce::int64) 4608 * 1024 * 1024;    // past what a 32-bit RIFF size can describe
+    constexpr juce::int64 maxGrowthKb = 64 * 1024;
+
+    const auto numFrames = targetBytes / (numChannels * bitsPerSample / 8);
+
+    // Every sample is distinct and survives a float round trip exactly, so misplaced blocks show up.
+    auto expected = [] (juce::int64 frame, int channel)
+    {
+        return (float) ((frame * numChannels + channel) % 1000003) / 1000003.0f - 0.5f;
+    };
+
+    report << "Wave64 streaming check: " << targetBytes / (1024 * 1024) << " MB of " << bitsPerSample << "-bit float\n";
+
+    if (directory.getBytesFreeOnVolume() < targetBytes + (juce::int64) 256 * 1024 * 1024)
+    {
+        report << "FAIL  not enough free space in " << directory.getFullPathName() << "\n";
+        return false;
+    }
+
+    auto file = directory.getNonexistentChildFile ("Wave64StreamingCheck", fileExtension, false);
+    const auto baselineKb = getProcessMemoryKb ("VmRSS");
+    resetPeakMemory();
+
+    Wave64AudioFormat format;
+    juce::AudioBuffer<float> buffer (numChannels, blockSize);
+    juce::String problem;
+    auto startMs = juce::Time::getMillisecondCounterHiRes();
+
+    {
+        auto out = file.createOutputStream();
+        std::unique_ptr<juce::AudioFormatWriter> writer (out != nullptr ? format.createWriterFor (out.get(), sampleRate, numChannels,
+                                                                                                  bitsPerSample, {}, 0)
+                                                                        : nullptr);
+        if (writer == nullptr)
+        {
+            report << "FAIL  couldn't create " << file.getFullPathName() << "\n";
+            return false;
+        }
+
+        out.release();
+
+        for (juce::int64 pos = 0; pos < numFrames && problem.isEmpty(); pos += blockSize)
+        {
+            const auto numThisTime = (int) std::min<juce::int64> (blockSize, numFrames - pos);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < numThisTime; ++i)
+                    buffer.setSample (ch, i, expected (pos + i, ch));
+
+            if (! writer->writeFromAudioSampleBuffer (buffer, 0, numThisTime))
+                problem = "write failed at frame " + juce::String (pos);
+        }
+    }
+
+    const auto writeSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    startMs = juce::Time::getMillisecondCounterHiRes();
+
+    if (problem.isEmpty())
+    {
+        auto in = file.createInputStream();
+        std::unique_ptr<juce::AudioFormatReader> reader (in != nullptr ? format.createReaderFor (in.release(), true) : nullptr);
+
+        if (reader == nullptr)
+            problem = "couldn't read the file back";
+        else if (reader->lengthInSamples != numFrames || (int) reader->numChannels != numChannels)
+            problem = "read back " + juce::String (reader->lengthInSamples) + " frames of " + juce::String (reader->numChannels)
+                        + " channels, expected " + juce::String (numFrames) + " of " + juce::String (numChannels);
+
+        for (juce::int64 pos = 0; pos < numFrames && problem.isEmpty(); pos += blockSize)
+        {
+            const auto numThisTime = (int) std::min<juce::int64> (blockSize, numFrames - pos);
+
+            if (! reader->read (&buffer, 0, numThisTime, pos, true, true))
+            {
+                problem = "read failed at frame " + juce::String (pos);
+                break;
+            }
+
+            for (int ch = 0; ch < numChannels && problem.isEmpty(); ++ch)
+                for (int i = 0; i < numThisTime; ++i)
+                    if (buffer.getSample (ch, i) != expected (pos + i, ch))
+                    {
+                        problem = "sample mismatch at frame " + juce::String (pos + i) + ", channel " + juce::String (ch);
+                        break;
+                    }
+        }
+    }
+
+    const auto readSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    const auto peakKb = getProcessMemoryKb ("VmHWM");
+    file.deleteFile();
+
+    report << "  write " << juce::String (writeSeconds, 1) << " s, read and verify " << juce::String (readSeconds, 1) << " s\n";
+
+    if (peakKb >= 0 && baselineKb >= 0)
+        report << "  peak resident memory " << peakKb / 1024 << " MB (" << (peakKb - baselineKb) / 1024 << " MB over the start)\n";
+    else
+        report << "  peak resident memory not available on this platform\n";
+
+    if (problem.isEmpty() && peakKb >= 0 && baselineKb >= 0 && peakKb - baselineKb > maxGrowthKb)
+        problem = "resident memory grew by more than " + juce::String (maxGrowthKb / 1024) + " MB";
+
+    report << (problem.isEmpty() ? "PASS\n" : "FAIL  " + problem + "\n");
+    return problem.isEmpty();
+}
@@ -0,0 +1,37 @@
+/*
+    Sony Wave64 (.w64) reader and writer.
+
+    W64 is RIFF/WAVE with 128-bit chunk IDs and 64-bit chunk sizes, so it has no 4 GB limit.
+    Both the reader and the writer stream through the file in bounded blocks; the writer
+    fills in the chunk sizes when it is closed.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class Wave64AudioFormat : public juce::AudioFormat
+{
+public:
+    Wave64AudioFormat();
+
+    static constexpr const char* fileExtension = ".w64";
+
+    juce::Array<int> getPossibleSampleRates() override;
+    juce::Array<int> getPossibleBitDepths() override      { return { 16, 24, 32 }; }
+    bool canDoStereo() override                           { return true; }
+    bool canDoMono() override                             { return true; }
+
+    juce::AudioFormatReader* createReaderFor (juce::InputStream* sourceStream, bool deleteStreamIfOpeningFails) override;
+
+    /** A bit depth of 32 writes IEEE float; 16 and 24 write integer PCM. */
+    juce::AudioFormatWriter* createWriterFor (juce::OutputStream* streamToWriteTo, double sampleRateToUse,
+                                              unsigned int numberOfChannels, int bitsPerSample,
+                                              const juce::StringPairArray& metadataValues, int qualityOptionIndex) override;
+
+    /** Writes a float file of more than 4 GB to directory, reads it back checking every sample,
+        and checks that peak resident memory (VmHWM, Linux only) stayed bounded throughout.
+        Appends the results to report and returns true if everything passed. The file is deleted.
+    */
+    static bool runStreamingCheck (const juce::File& directory, juce::String& report);
+};